@@ -1,10 +1,24 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // ftruncate, mmap
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 #include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "SDL.h"
+#include "chip8_core.h"
+#include "chip8_soa.h"
+#include "chip8_audio.h"
 
 typedef struct {
     SDL_Window          *window;
@@ -13,18 +27,6 @@ typedef struct {
     SDL_AudioDeviceID   dev;
 } sdl_t;
 
-typedef enum {
-    QUIT = 0,
-    RUNNING,
-    PAUSED,
-} emulator_state_t;
-
-typedef enum {
-    CHIP8,
-    SUPERCHIP,
-    XOCHIP,
-} extension_t;
-
 typedef struct {
     char        *window_title;
     uint32_t    window_width;
@@ -36,37 +38,185 @@ typedef struct {
     uint32_t    insts_per_sec;
     uint32_t    square_wave_freq;
     uint32_t    audio_sample_rate;
+    uint16_t    audio_buffer_samples;
     int16_t     volume;
     float       color_lerp_rate;
-    extension_t current_extension;
+    chip8_config_t  core;       // Extension and seed, passed to the core
+    uint32_t    max_frames;     // Stop after this many frames, 0 runs until quit
+    const char  *slots_path;    // Memory-mapped savestate slot file
+    uint32_t    slot_count;
+    int32_t     load_slot;      // Slot to restore at startup, -1 for none
+    uint32_t    rewind_budget_mb;   // Memory for rewind history, 0 disables rewind
+    uint32_t    run_ahead_frames;   // Frames to speculatively emulate before presenting
+    const char  *timing_path;       // Chrome trace of per-frame phase timings
 } config_t;
 
+// Host time spent per frame on run-ahead: snapshot, speculative frames, present, restore
+typedef struct {
+    uint64_t    frames;
+    double      sum_ms;
+    double      max_ms;
+} run_ahead_stats_t;
+
+// Main loop phases timed by --timing
+typedef enum {
+    PHASE_INPUT,
+    PHASE_EMULATE,
+    PHASE_RUN_AHEAD,
+    PHASE_DELAY,
+    PHASE_RENDER,
+    PHASE_PRESENT,
+    PHASE_TIMERS,
+    PHASE_COUNT,
+} frame_phase_t;
+
+const char *frame_phase_names[PHASE_COUNT] = {
+    "handle_input", "emulate", "run_ahead", "SDL_Delay", "update_screen", "SDL_RenderPresent", "update_timers",
+};
+
+#define TIMING_FRAMES   36000   // Newest 10 minutes at 60 Hz go to the trace file
+#define TIMING_WINDOW   600     // Rolling percentiles every 10 seconds
+
+// Performance counter values, a phase that did not run this frame has start 0
+typedef struct {
+    uint64_t    frame;
+    uint64_t    start;
+    uint64_t    end;
+    uint64_t    phase_start[PHASE_COUNT];
+    uint64_t    phase_end[PHASE_COUNT];
+    uint32_t    delay_requested_ms;
+} frame_timing_t;
+
+typedef struct {
+    frame_timing_t  *frames;    // Ring of TIMING_FRAMES, NULL when --timing is off
+    uint64_t        count;      // Frames recorded so far
+    uint64_t        origin;     // Trace timestamps are relative to startup
+    frame_timing_t  current;
+} timing_t;
+
+// Performance overlay, H toggles it. Text comes from a 3x5 font baked into one
+// texture at startup, so drawing is a batch of texture copies and filled rects.
+#define HUD_FIRST_CHAR      ' '
+#define HUD_GLYPHS          64      // ' ' through '_', lowercase is drawn as uppercase
+#define HUD_GLYPH_W         3
+#define HUD_GLYPH_H         5
+#define HUD_LINES           4
+#define HUD_LINE_CHARS      32
+#define HUD_GRAPH_FRAMES    120
+#define HUD_GRAPH_MAX_MS    33.3    // Top of the frame time graph, two 60 Hz frames
+#define HUD_DROPPED_MS      25.0    // A frame this long missed at least one 60 Hz slot
+#define HUD_REFRESH_MS      500     // Text is reformatted twice a second
+
+typedef struct {
+    bool        visible;
+    SDL_Texture *atlas;
+    uint32_t    scale;              // Screen pixels per font pixel
+    float       frame_ms[HUD_GRAPH_FRAMES]; // Ring, newest at graph_head - 1
+    uint32_t    graph_head;
+    uint64_t    dropped;
+    // Accumulated since the text was last refreshed
+    uint64_t    window_start;
+    uint32_t    window_frames;
+    uint64_t    window_insts;
+    double      window_core_ms;
+    double      window_render_ms;
+    uint32_t    window_min_fill;    // Lowest audio buffer fill seen, in samples
+    char        lines[HUD_LINES][HUD_LINE_CHARS];
+} hud_t;
+
+// Frontend-only display state, kept out of chip8_t so machines stay small
 typedef struct {
-    uint16_t    opcode;
-    uint16_t    NNN;
-    uint8_t     NN;
-    uint8_t     N;
-    uint8_t     X;
-    uint8_t     Y;
-} instruction_t;
+    uint32_t    pixel_color[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT];  // Color fade per pixel
+    hud_t       hud;
+} render_t;
+
+// Savestate slots live in one fixed-size block, either a memory-mapped file
+// (--slots-file) that persists across runs or plain heap memory. A slot holds
+// a chip8_save_state() blob, whose own checksum tells whether it is valid.
+#define SLOT_FILE_MAGIC     "C8SL"
+#define SLOT_FILE_VERSION   1
+#define SLOT_FILE_HEADER    64
+#define SLOT_SIZE           ((CHIP8_STATE_SIZE + 63) & ~63)
+#define SLOT_HOTKEYS        4   // F1-F4 save, F5-F8 load slots 0-3
 
 typedef struct {
-    emulator_state_t    state;
-    uint8_t             ram[4096];
-    bool                display[64*32];
-    uint32_t            pixel_color[64*32];
-    uint16_t            stack[12];
-    uint16_t            *stack_ptr;
-    uint8_t             V[16];
-    uint16_t            I;
-    uint16_t            PC;
-    uint8_t             delay_timer;
-    uint8_t             sound_timer;
-    bool                keypad[16];
-    const char          *rom_name;
-    instruction_t       inst;
-    bool                draw;
-} chip8_t;
+    uint8_t         *base;          // File header followed by count slots
+    size_t          size;
+    uint32_t        count;
+    uint32_t        next_checkpoint;
+    bool            mapped;
+#ifdef _WIN32
+    HANDLE          file;
+    HANDLE          mapping;
+#else
+    int             fd;
+#endif
+    SDL_Thread      *flusher;       // Syncs the mapping to disk off the emulation thread
+    SDL_sem         *flush_request;
+    SDL_atomic_t    quit;
+} slot_store_t;
+
+// XO-CHIP audio: 128 1-bit samples played at 4000*2^((pitch-64)/48) Hz
+typedef struct {
+    uint8_t     pattern[16];
+    uint8_t     pitch;
+} audio_pattern_t;
+
+// Triple buffer between emulation and the audio callback, neither side ever waits.
+// Emulation fills the back slot and swaps it with the middle one, the callback
+// swaps the middle slot into front only if it was marked dirty.
+#define AUDIO_SLOT_DIRTY 0x4
+
+typedef struct {
+    audio_pattern_t slots[3];
+    SDL_atomic_t    middle;
+    int             back;   // Owned by the emulation thread
+    int             front;  // Owned by the audio callback
+} audio_mailbox_t;
+
+// Sound timer on/off edge, time is in emulated audio samples
+typedef struct {
+    uint64_t    time;
+    uint64_t    host_time;  // Performance counter when pushed, for latency measurement
+    bool        on;
+} sound_edge_t;
+
+// Single producer (emulation), single consumer (audio callback) ring of edges.
+// head/tail are free running counters, only their owner ever writes them.
+#define SOUND_RING_SIZE 256
+
+typedef struct {
+    sound_edge_t    edges[SOUND_RING_SIZE];
+    SDL_atomic_t    head;
+    SDL_atomic_t    tail;
+} sound_ring_t;
+
+// End-to-end latency from the sound timer being set to its first sample
+// reaching the DAC, assuming the device plays one buffer behind the callback
+typedef struct {
+    uint32_t    count;
+    double      sum_ms;
+    double      min_ms;
+    double      max_ms;
+    uint32_t    late_callbacks; // Callback gaps over 1.5 buffers, likely underruns
+    uint64_t    last_callback;
+} audio_latency_t;
+
+typedef struct {
+    config_t            *config;
+    chip8_audio_t       synth;          // Gate and pattern owned by the audio callback
+    audio_mailbox_t     mailbox;
+    uint32_t            sample_rate;    // Negotiated device rate (have.freq)
+    sound_ring_t        ring;
+    uint32_t            buffer_samples; // Negotiated device buffer size (have.samples)
+    bool                sound_on;       // Last edge pushed, owned by the emulation thread
+    uint64_t            clock;          // Samples rendered by the audio callback
+    int64_t             time_offset;    // Device clock minus emulated clock
+    bool                synced;
+    bool                measure_latency;
+    audio_latency_t     latency;        // Owned by the audio callback
+    SDL_atomic_t        callback_ticks; // Low 32 bits of the performance counter at the last callback
+} audio_t;
 
 uint32_t color_lerp(const uint32_t start_color, const uint32_t end_color, const float t)
 {
@@ -88,22 +238,159 @@ uint32_t color_lerp(const uint32_t start_color, const uint32_t end_color, const
     return (ret_r << 24) | (ret_g << 16) | (ret_b << 8) | ret_a;
 }
 
+void init_audio(audio_t *audio, config_t *config)
+{
+    *audio = (audio_t) {
+.config     = config,
+        .mailbox    = {.back = 1, .front = 2},
+    };
+    SDL_AtomicSet(&audio->mailbox.middle, 0);
+    SDL_AtomicSet(&audio->ring.head, 0);
+    SDL_AtomicSet(&audio->ring.tail, 0);
+}
+
+// Called from the emulation thread when the sound timer starts or stops at emulated time
+// Never blocks, if the callback fell a full ring behind the edge is retried on the next call
+void push_sound_edge(audio_t *audio, const bool on, const uint64_t time)
+{
+    sound_ring_t *ring = &audio->ring;
+    const uint32_t head = (uint32_t)SDL_AtomicGet(&ring->head);
+    const uint32_t tail = (uint32_t)SDL_AtomicGet(&ring->tail);
+
+    if (head - tail >= SOUND_RING_SIZE)
+        return;
+
+    ring->edges[head & (SOUND_RING_SIZE - 1)] = (sound_edge_t) {
+        .time       = time,
+        .host_time  = audio->measure_latency ? SDL_GetPerformanceCounter() : 0,
+        .on         = on,
+    };
+    SDL_AtomicSet(&ring->head, (int)(head + 1));
+    audio->sound_on = on;
+}
+
+// Called from the emulation thread whenever F002/FX3A changed the pattern or pitch
+void publish_audio_pattern(audio_t *audio, const chip8_t *chip8)
+{
+    audio_mailbox_t *mb = &audio->mailbox;
+    audio_pattern_t *slot = &mb->slots[mb->back];
+
+    memcpy(slot->pattern, chip8->audio_pattern, sizeof(slot->pattern));
+    slot->pitch = chip8->pitch;
+
+    mb->back = SDL_AtomicSet(&mb->middle, mb->back | AUDIO_SLOT_DIRTY) & ~AUDIO_SLOT_DIRTY;
+}
+
+const audio_pattern_t *consume_audio_pattern(audio_mailbox_t *mb)
+{
+    if (SDL_AtomicGet(&mb->middle) & AUDIO_SLOT_DIRTY)
+        mb->front = SDL_AtomicSet(&mb->middle, mb->front) & ~AUDIO_SLOT_DIRTY;
+
+    return &mb->slots[mb->front];
+}
+
+// Called from the audio callback, offset is where the sound starts in the current buffer
+void record_audio_latency(audio_t *audio, const sound_edge_t *edge, const uint64_t now, const uint32_t offset)
+{
+    audio_latency_t *stats = &audio->latency;
+    const double ms = (double)(now - edge->host_time) * 1000 / SDL_GetPerformanceFrequency() +
+                      (double)(offset + audio->buffer_samples) * 1000 / audio->sample_rate;
+
+    if (stats->count == 0 || ms < stats->min_ms)
+        stats->min_ms = ms;
+    if (ms > stats->max_ms)
+        stats->max_ms = ms;
+    stats->sum_ms += ms;
+    stats->count++;
+}
+
+void print_audio_latency(const audio_t *audio)
+{
+    const audio_latency_t *stats = &audio->latency;
+
+    printf("Audio: %u Hz, %u sample buffer (%.2f ms)\n", audio->sample_rate, audio->buffer_samples,
+           (double)audio->buffer_samples * 1000 / audio->sample_rate);
+    if (stats->count)
+        printf("Sound latency: avg %.2f ms, min %.2f ms, max %.2f ms over %u beeps\n",
+               stats->sum_ms / stats->count, stats->min_ms, stats->max_ms, stats->count);
+    printf("Late audio callbacks (possible underruns): %u\n", stats->late_callbacks);
+}
+
+// Pattern and pitch changes are picked up between chunks, so a new
+// XO-CHIP pattern reaches the speaker within CHIP8_AUDIO_CHUNK samples
+void render_audio(audio_t *audio, int16_t *audio_data, const uint32_t num_samples)
+{
+    if (!audio->synth.gate || !audio->synth.xochip) {
+        chip8_audio_render(&audio->synth, audio_data, num_samples);
+        return;
+    }
+
+    uint32_t done = 0;
+    while (done < num_samples) {
+        const uint32_t chunk = (num_samples - done < CHIP8_AUDIO_CHUNK) ? num_samples - done : CHIP8_AUDIO_CHUNK;
+        const audio_pattern_t *pat = consume_audio_pattern(&audio->mailbox);
+
+        chip8_audio_set_pattern(&audio->synth, pat->pattern, pat->pitch);
+        chip8_audio_render(&audio->synth, &audio_data[done], chunk);
+        done += chunk;
+    }
+}
+
 void audio_callback(void *userdata, uint8_t *stream, int len)
 {
-    config_t *config = (config_t *)userdata;
-    
+    audio_t *audio = (audio_t *)userdata;
+    sound_ring_t *ring = &audio->ring;
     int16_t *audio_data = (int16_t *)stream;
-    uint32_t running_sample_index = 0;
-    const int32_t square_wave_period = config->audio_sample_rate / config->square_wave_freq;
-    const int32_t half_square_wave_period = square_wave_period / 2;
-
-    int i;
-    for (i = 0; i < len / 2; ++i)
-        audio_data[i] = ((running_sample_index++ / half_square_wave_period) % 2) ? 
-                        config->volume : -config->volume;
+    const uint32_t num_samples = len / 2;
+
+    // Edges are played this far behind emulation so they normally arrive before they are due
+    const int64_t latency = audio->buffer_samples + audio->sample_rate / 60;
+    const int64_t start = audio->clock;
+
+    const uint64_t now = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&audio->callback_ticks, (int)(uint32_t)now);
+    if (audio->measure_latency) {
+        // A gap well over one buffer between callbacks means the device likely ran dry
+        const uint64_t buffer_ticks = (uint64_t)audio->buffer_samples * SDL_GetPerformanceFrequency() / audio->sample_rate;
+        if (audio->latency.last_callback && now - audio->latency.last_callback > buffer_ticks * 3 / 2)
+            audio->latency.late_callbacks++;
+        audio->latency.last_callback = now;
+    }
+
+    const uint32_t head = (uint32_t)SDL_AtomicGet(&ring->head);
+    uint32_t tail = (uint32_t)SDL_AtomicGet(&ring->tail);
+    uint32_t pos = 0;
+
+    while (pos < num_samples && tail != head) {
+        const sound_edge_t *edge = &ring->edges[tail & (SOUND_RING_SIZE - 1)];
+        int64_t due = (int64_t)edge->time + audio->time_offset;
+
+        // Resync when emulation drifted out of the latency window (start, pause, slow frames)
+        if (!audio->synced || due < start || due > start + 4 * latency) {
+            audio->time_offset = start + latency - (int64_t)edge->time;
+            audio->synced = true;
+            due = start + latency;
+        }
+
+        if (due >= start + num_samples)
+            break;
+
+        const uint32_t offset = (due - start > pos) ? (uint32_t)(due - start) : pos;
+        render_audio(audio, &audio_data[pos], offset - pos);
+        pos = offset;
+
+        if (audio->measure_latency && edge->on && !audio->synth.gate)
+            record_audio_latency(audio, edge, now, offset);
+
+        audio->synth.gate = edge->on;
+        SDL_AtomicSet(&ring->tail, (int)++tail);
+    }
+
+    render_audio(audio, &audio_data[pos], num_samples - pos);
+    audio->clock += num_samples;
 }
 
-bool init_sdl(sdl_t *sdl, config_t *config)
+bool init_sdl(sdl_t *sdl, config_t *config, audio_t *audio)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0) {
         SDL_Log("Could not initialize SDL %s\n", SDL_GetError());
@@ -130,15 +417,17 @@ bool init_sdl(sdl_t *sdl, config_t *config)
     }
 
     sdl->want = (SDL_AudioSpec) {
-        .freq       = 44100,
+        .freq       = config->audio_sample_rate,
         .format     = AUDIO_S16LSB,
         .channels   = 1,
-        .samples    = 512,
+        .samples    = config->audio_buffer_samples,
         .callback   = audio_callback,
-        .userdata   = config,
+        .userdata   = audio,
     };
 
-    sdl->dev = SDL_OpenAudioDevice(NULL, 0, &sdl->want, &sdl->have, 0);
+    // Rate and buffer size are only requests, the waveform generators follow whatever we get
+    sdl->dev = SDL_OpenAudioDevice(NULL, 0, &sdl->want, &sdl->have,
+                                   SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
 
     if (sdl->dev == 0) {
         SDL_Log("Could not get an Audio Device %s\n", SDL_GetError());
@@ -150,7 +439,20 @@ bool init_sdl(sdl_t *sdl, config_t *config)
             SDL_Log("Could not get an Audio Spec\n");
             return false;
         }
-        
+
+    if ((sdl->want.freq != sdl->have.freq) || (sdl->want.samples != sdl->have.samples))
+        SDL_Log("Requested %d Hz, %u sample audio buffer, got %d Hz, %u samples\n",
+                sdl->want.freq, sdl->want.samples, sdl->have.freq, sdl->have.samples);
+
+    // Device starts paused, safe to set before the callback ever runs
+    audio->sample_rate = sdl->have.freq;
+    audio->buffer_samples = sdl->have.samples;
+    audio->measure_latency = true;
+    chip8_audio_init(&audio->synth, audio->sample_rate, config->square_wave_freq, config->volume,
+                     config->core.current_extension);
+
+    // Keep the device running, sound timer edges gate the output sample accurately
+    SDL_PauseAudioDevice(sdl->dev, 0);
 
     return true;
 }
@@ -168,79 +470,263 @@ bool set_config_from_args(config_t *config, const int argc, char **argv)
         .insts_per_sec      = 700,
         .square_wave_freq   = 440,
         .audio_sample_rate  = 44100,
+        .audio_buffer_samples = 512,
+        .rewind_budget_mb   = 16,
+        .slot_count         = 256,
+        .load_slot          = -1,
         .volume             = 3000,
         .color_lerp_rate    = 0.7,
-        .current_extension  = CHIP8,
+        .core.current_extension = CHIP8_EXT_CHIP8,
     };
 
+    bool seed_set = false;
     int8_t i;
-    for (i = 1; i < argc; ++i)
-        if (strncmp(argv[i], "--scale-factor", strlen("--scale-factor")) == 0)
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--scale-factor", strlen("--scale-factor")) == 0 && i + 1 < argc)
             config->scale_factor = (uint32_t)strtol(argv[++i], NULL, 10);
 
+        if (strncmp(argv[i], "--extension", strlen("--extension")) == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "chip8") == 0)
+                config->core.current_extension = CHIP8_EXT_CHIP8;
+            else if (strcmp(argv[i], "superchip") == 0)
+                config->core.current_extension = CHIP8_EXT_SUPERCHIP;
+            else if (strcmp(argv[i], "xochip") == 0)
+                config->core.current_extension = CHIP8_EXT_XOCHIP;
+            else {
+                SDL_Log("Unknown extension %s, expected chip8, superchip or xochip\n", argv[i]);
+                return false;
+            }
+        }
+
+        if (strncmp(argv[i], "--sample-rate", strlen("--sample-rate")) == 0 && i + 1 < argc)
+            config->audio_sample_rate = (uint32_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--audio-buffer", strlen("--audio-buffer")) == 0 && i + 1 < argc)
+            config->audio_buffer_samples = (uint16_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--rewind-mb", strlen("--rewind-mb")) == 0 && i + 1 < argc)
+            config->rewind_budget_mb = (uint32_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--run-ahead", strlen("--run-ahead")) == 0 && i + 1 < argc)
+            config->run_ahead_frames = (uint32_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--slots-file", strlen("--slots-file")) == 0 && i + 1 < argc)
+            config->slots_path = argv[++i];
+
+        if (strncmp(argv[i], "--slot-count", strlen("--slot-count")) == 0 && i + 1 < argc)
+            config->slot_count = (uint32_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--load-slot", strlen("--load-slot")) == 0 && i + 1 < argc)
+            config->load_slot = (int32_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--seed", strlen("--seed")) == 0 && i + 1 < argc) {
+            config->core.seed = strtoull(argv[++i], NULL, 10);
+            seed_set = true;
+        }
+
+        if (strncmp(argv[i], "--frames", strlen("--frames")) == 0 && i + 1 < argc)
+            config->max_frames = (uint32_t)strtol(argv[++i], NULL, 10);
+
+        if (strncmp(argv[i], "--timing", strlen("--timing")) == 0 && i + 1 < argc)
+            config->timing_path = argv[++i];
+    }
+
+    // A fresh seed every run unless --seed replays a particular one
+    if (!seed_set)
+        config->core.seed = (uint64_t)time(NULL);
+
+    if (config->audio_sample_rate < 8000 || config->audio_sample_rate > 192000) {
+        SDL_Log("--sample-rate must be between 8000 and 192000 Hz\n");
+        return false;
+    }
+
+    // SDL wants a power of two
+    if (config->audio_buffer_samples < 16 ||
+        (config->audio_buffer_samples & (config->audio_buffer_samples - 1)) != 0) {
+        SDL_Log("--audio-buffer must be a power of two of at least 16 samples\n");
+        return false;
+    }
+
+    if (config->run_ahead_frames > 8) {
+        SDL_Log("--run-ahead supports at most 8 frames\n");
+        return false;
+    }
+
+    if (config->slot_count < SLOT_HOTKEYS || config->slot_count > 65536) {
+        SDL_Log("--slot-count must be between %d and 65536\n", SLOT_HOTKEYS);
+        return false;
+    }
+
+    if (config->load_slot >= (int32_t)config->slot_count) {
+        SDL_Log("--load-slot must be below --slot-count (%u)\n", config->slot_count);
+        return false;
+    }
+
     return true;
 }
 
-bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[])
+int slot_flusher_thread(void *data)
 {
-    const uint32_t entry_point = 0x200; // CHIP8 ROM entry point
-    const uint8_t font[] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
+    slot_store_t *store = (slot_store_t *)data;
+
+    while (!SDL_AtomicGet(&store->quit)) {
+        SDL_SemWait(store->flush_request);
+        // Saves landing while we sync coalesce into the next round
+        while (SDL_SemTryWait(store->flush_request) == 0)
+            ;
+#ifdef _WIN32
+        FlushViewOfFile(store->base, store->size);
+        FlushFileBuffers(store->file);
+#else
+        msync(store->base, store->size, MS_SYNC);
+#endif
+    }
+    return 0;
+}
+
+void close_slot_store(slot_store_t *store)
+{
+    if (store->flusher) {
+        SDL_AtomicSet(&store->quit, 1);
+        SDL_SemPost(store->flush_request);
+        SDL_WaitThread(store->flusher, NULL);
+    }
+    if (store->flush_request)
+        SDL_DestroySemaphore(store->flush_request);
+
+    if (!store->mapped) {
+        free(store->base);
+        return;
+    }
+
+#ifdef _WIN32
+    FlushViewOfFile(store->base, store->size);
+    UnmapViewOfFile(store->base);
+    CloseHandle(store->mapping);
+    CloseHandle(store->file);
+#else
+    msync(store->base, store->size, MS_SYNC);
+    munmap(store->base, store->size);
+    close(store->fd);
+#endif
+}
 
-    // Initialize entire CHIP8 machine
-    memset(chip8, 0, sizeof(chip8_t));
+// Map path, creating it when missing, or fall back to heap slots when path is NULL
+bool open_slot_store(slot_store_t *store, const char *path, const uint32_t count)
+{
+    memset(store, 0, sizeof(slot_store_t));
+    store->count = count;
+    store->size = SLOT_FILE_HEADER + (size_t)count * SLOT_SIZE;
+    store->next_checkpoint = SLOT_HOTKEYS;
+
+    if (!path) {
+        store->base = calloc(1, store->size);
+        if (!store->base) {
+            SDL_Log("Could not allocate %u savestate slots\n", count);
+            return false;
+        }
+        return true;
+    }
 
-    memcpy(chip8->ram, font, sizeof(font));
+#ifdef _WIN32
+    store->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (store->file == INVALID_HANDLE_VALUE) {
+        SDL_Log("Could not open slot file %s\n", path);
+        return false;
+    }
 
-    FILE *rom = fopen(rom_name, "rb");
-    if (!rom) {
-        SDL_Log("ROM file %s is invalid or does not exist\n", rom_name);
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(store->file, &file_size);
+    const bool created = (file_size.QuadPart == 0);
+
+    store->mapping = CreateFileMappingA(store->file, NULL, PAGE_READWRITE,
+                                        (DWORD)((uint64_t)store->size >> 32), (DWORD)store->size, NULL);
+    store->base = store->mapping ? MapViewOfFile(store->mapping, FILE_MAP_ALL_ACCESS, 0, 0, store->size) : NULL;
+    if (!store->base) {
+        SDL_Log("Could not map slot file %s\n", path);
+        if (store->mapping)
+            CloseHandle(store->mapping);
+        CloseHandle(store->file);
+        return false;
+    }
+#else
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0) {
+        SDL_Log("Could not open slot file %s\n", path);
         return false;
     }
 
-    fseek(rom, 0, SEEK_END);
-    const size_t rom_size = ftell(rom);
-    const size_t max_size = sizeof(chip8->ram) - entry_point;
-    rewind(rom);
+    const off_t file_size = lseek(store->fd, 0, SEEK_END);
+    const bool created = (file_size == 0);
 
-    if (rom_size > max_size) {
-        SDL_Log("ROM file %s is too big. ROM size: %llu, max allowed size: %llu\n", 
-                rom_name, (long long unsigned)rom_size, (long long unsigned)max_size);
+    if ((created || (size_t)file_size < store->size) && ftruncate(store->fd, store->size) != 0) {
+        SDL_Log("Could not size slot file %s\n", path);
+        close(store->fd);
         return false;
     }
-    
-    if (fread(&chip8->ram[entry_point], rom_size, 1, rom) != 1) {
-        SDL_Log("Could not read ROM file %s into CHIP8 memory\n", rom_name);
+
+    store->base = mmap(NULL, store->size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if (store->base == MAP_FAILED) {
+        SDL_Log("Could not map slot file %s\n", path);
+        close(store->fd);
+        return false;
+    }
+#endif
+    store->mapped = true;
+
+    uint8_t *header = store->base;
+    const uint32_t slot_size = SLOT_SIZE;
+    if (created) {
+        memcpy(header, SLOT_FILE_MAGIC, 4);
+        header[4] = SLOT_FILE_VERSION;
+        memcpy(&header[8], &slot_size, sizeof(slot_size));
+    } else if (memcmp(header, SLOT_FILE_MAGIC, 4) != 0 || header[4] != SLOT_FILE_VERSION ||
+               memcmp(&header[8], &slot_size, sizeof(slot_size)) != 0) {
+        // Leave the file alone, it may hold states from another build
+        SDL_Log("Slot file %s has an incompatible layout\n", path);
+        store->count = 0;
+        close_slot_store(store);
         return false;
     }
 
-    fclose(rom);
-    
-    chip8->state = RUNNING;
-    chip8->PC = entry_point;
-    chip8->rom_name = rom_name;
-    chip8->stack_ptr = &chip8->stack[0];
-    memset(chip8->pixel_color, config.bg_color, sizeof(chip8->pixel_color));
+    store->flush_request = SDL_CreateSemaphore(0);
+    store->flusher = SDL_CreateThread(slot_flusher_thread, "slot flusher", store);
+    if (!store->flush_request || !store->flusher) {
+        SDL_Log("Could not start slot flusher thread %s\n", SDL_GetError());
+        close_slot_store(store);
+        return false;
+    }
 
     return true;
 }
 
+uint8_t *slot_data(const slot_store_t *store, const uint32_t slot)
+{
+    return &store->base[SLOT_FILE_HEADER + (size_t)slot * SLOT_SIZE];
+}
+
+// Serialize straight into the slot, the flusher thread makes it durable later
+bool save_to_slot(slot_store_t *store, const uint32_t slot, const chip8_t *chip8)
+{
+    if (slot >= store->count)
+        return false;
+
+    chip8_save_state(chip8, slot_data(store, slot));
+    if (store->flusher)
+        SDL_SemPost(store->flush_request);
+    return true;
+}
+
+bool load_from_slot(const slot_store_t *store, const uint32_t slot, chip8_t *chip8)
+{
+    if (slot >= store->count)
+        return false;
+
+    return chip8_load_state(chip8, slot_data(store, slot), CHIP8_STATE_SIZE);
+}
+
 void final_cleanup(const sdl_t sdl)
 {
     SDL_DestroyRenderer(sdl.renderer);
@@ -260,7 +746,168 @@ void clear_screen(const sdl_t sdl, const config_t config)
     SDL_RenderClear(sdl.renderer);
 }
 
-void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8)
+double ticks_to_ms(const uint64_t ticks)
+{
+    return (double)ticks * 1000 / SDL_GetPerformanceFrequency();
+}
+
+// Rows of 3 bits, most significant bit on the left
+const uint8_t hud_font[HUD_GLYPHS][HUD_GLYPH_H] = {
+    ['%' - HUD_FIRST_CHAR] = {5, 1, 2, 4, 5}, ['-' - HUD_FIRST_CHAR] = {0, 0, 7, 0, 0},
+    ['.' - HUD_FIRST_CHAR] = {0, 0, 0, 0, 2}, ['/' - HUD_FIRST_CHAR] = {1, 1, 2, 4, 4},
+    ['0' - HUD_FIRST_CHAR] = {7, 5, 5, 5, 7}, ['1' - HUD_FIRST_CHAR] = {2, 6, 2, 2, 7},
+    ['2' - HUD_FIRST_CHAR] = {7, 1, 7, 4, 7}, ['3' - HUD_FIRST_CHAR] = {7, 1, 7, 1, 7},
+    ['4' - HUD_FIRST_CHAR] = {5, 5, 7, 1, 1}, ['5' - HUD_FIRST_CHAR] = {7, 4, 7, 1, 7},
+    ['6' - HUD_FIRST_CHAR] = {7, 4, 7, 5, 7}, ['7' - HUD_FIRST_CHAR] = {7, 1, 1, 1, 1},
+    ['8' - HUD_FIRST_CHAR] = {7, 5, 7, 5, 7}, ['9' - HUD_FIRST_CHAR] = {7, 5, 7, 1, 7},
+    [':' - HUD_FIRST_CHAR] = {0, 2, 0, 2, 0},
+    ['A' - HUD_FIRST_CHAR] = {2, 5, 7, 5, 5}, ['B' - HUD_FIRST_CHAR] = {6, 5, 6, 5, 6},
+    ['C' - HUD_FIRST_CHAR] = {3, 4, 4, 4, 3}, ['D' - HUD_FIRST_CHAR] = {6, 5, 5, 5, 6},
+    ['E' - HUD_FIRST_CHAR] = {7, 4, 6, 4, 7}, ['F' - HUD_FIRST_CHAR] = {7, 4, 6, 4, 4},
+    ['G' - HUD_FIRST_CHAR] = {3, 4, 5, 5, 3}, ['H' - HUD_FIRST_CHAR] = {5, 5, 7, 5, 5},
+    ['I' - HUD_FIRST_CHAR] = {7, 2, 2, 2, 7}, ['J' - HUD_FIRST_CHAR] = {1, 1, 1, 5, 2},
+    ['K' - HUD_FIRST_CHAR] = {5, 5, 6, 5, 5}, ['L' - HUD_FIRST_CHAR] = {4, 4, 4, 4, 7},
+    ['M' - HUD_FIRST_CHAR] = {5, 7, 7, 5, 5}, ['N' - HUD_FIRST_CHAR] = {6, 5, 5, 5, 5},
+    ['O' - HUD_FIRST_CHAR] = {2, 5, 5, 5, 2}, ['P' - HUD_FIRST_CHAR] = {6, 5, 6, 4, 4},
+    ['Q' - HUD_FIRST_CHAR] = {2, 5, 5, 6, 3}, ['R' - HUD_FIRST_CHAR] = {6, 5, 6, 5, 5},
+    ['S' - HUD_FIRST_CHAR] = {3, 4, 2, 1, 6}, ['T' - HUD_FIRST_CHAR] = {7, 2, 2, 2, 2},
+    ['U' - HUD_FIRST_CHAR] = {5, 5, 5, 5, 7}, ['V' - HUD_FIRST_CHAR] = {5, 5, 5, 5, 2},
+    ['W' - HUD_FIRST_CHAR] = {5, 5, 7, 7, 5}, ['X' - HUD_FIRST_CHAR] = {5, 5, 2, 5, 5},
+    ['Y' - HUD_FIRST_CHAR] = {5, 5, 2, 2, 2}, ['Z' - HUD_FIRST_CHAR] = {7, 1, 2, 4, 7},
+};
+
+// Bake every glyph side by side into one white-on-transparent texture
+bool init_hud(hud_t *hud, const sdl_t sdl, const config_t config)
+{
+    *hud = (hud_t){
+        .scale          = config.scale_factor / 6 ? config.scale_factor / 6 : 1,
+        .window_start   = SDL_GetPerformanceCounter(),
+    };
+
+    uint32_t pixels[HUD_GLYPH_H][HUD_GLYPHS * HUD_GLYPH_W] = {0};
+    uint32_t g, x, y;
+    for (g = 0; g < HUD_GLYPHS; ++g)
+        for (y = 0; y < HUD_GLYPH_H; ++y)
+            for (x = 0; x < HUD_GLYPH_W; ++x)
+                if (hud_font[g][y] & (4 >> x))
+                    pixels[y][g * HUD_GLYPH_W + x] = 0xFFFFFFFF;
+
+    hud->atlas = SDL_CreateTexture(sdl.renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC,
+                                   HUD_GLYPHS * HUD_GLYPH_W, HUD_GLYPH_H);
+    if (!hud->atlas || SDL_UpdateTexture(hud->atlas, NULL, pixels, sizeof(pixels[0])) != 0) {
+        SDL_Log("Could not create HUD font texture %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(hud->atlas, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+// Samples still queued in the device, estimated: each callback hands it one full
+// buffer, which then drains at the sample rate until the next callback. Near
+// zero means the next late callback is an audible underrun.
+uint32_t audio_buffer_fill(audio_t *audio)
+{
+    const uint32_t elapsed = (uint32_t)SDL_GetPerformanceCounter() -
+                             (uint32_t)SDL_AtomicGet(&audio->callback_ticks);
+    const uint64_t played = (uint64_t)elapsed * audio->sample_rate / SDL_GetPerformanceFrequency();
+    return played < audio->buffer_samples ? audio->buffer_samples - (uint32_t)played : 0;
+}
+
+// Called once per emulated frame with the phase timings of that frame
+void record_hud_frame(hud_t *hud, const frame_timing_t *timing, const uint32_t insts, audio_t *audio)
+{
+    const double frame_ms = ticks_to_ms(timing->end - timing->start);
+    hud->frame_ms[hud->graph_head++ % HUD_GRAPH_FRAMES] = (float)frame_ms;
+    if (frame_ms >= HUD_DROPPED_MS)
+        hud->dropped++;
+
+    const uint32_t fill = audio_buffer_fill(audio);
+    if (hud->window_frames == 0 || fill < hud->window_min_fill)
+        hud->window_min_fill = fill;
+    hud->window_frames++;
+    hud->window_insts += insts;
+    hud->window_core_ms += ticks_to_ms(timing->phase_end[PHASE_EMULATE] - timing->phase_start[PHASE_EMULATE]) +
+                           ticks_to_ms(timing->phase_end[PHASE_RUN_AHEAD] - timing->phase_start[PHASE_RUN_AHEAD]);
+    hud->window_render_ms += ticks_to_ms(timing->phase_end[PHASE_RENDER] - timing->phase_start[PHASE_RENDER]) +
+                             ticks_to_ms(timing->phase_end[PHASE_PRESENT] - timing->phase_start[PHASE_PRESENT]);
+
+    const double window_ms = ticks_to_ms(timing->end - hud->window_start);
+    if (window_ms < HUD_REFRESH_MS)
+        return;
+
+    snprintf(hud->lines[0], HUD_LINE_CHARS, "FPS %.1f  DROPPED %llu",
+             hud->window_frames * 1000 / window_ms, (long long unsigned)hud->dropped);
+    snprintf(hud->lines[1], HUD_LINE_CHARS, "IPS %.0f", hud->window_insts * 1000 / window_ms);
+    snprintf(hud->lines[2], HUD_LINE_CHARS, "CORE %.3f  DRAW %.3f MS",
+             hud->window_core_ms / hud->window_frames, hud->window_render_ms / hud->window_frames);
+    // Against the device buffer negotiated from --audio-buffer, the latency target
+    snprintf(hud->lines[3], HUD_LINE_CHARS, "AUDIO FILL %u/%u MIN %u",
+             audio_buffer_fill(audio), audio->buffer_samples, hud->window_min_fill);
+
+    hud->window_start = timing->end;
+    hud->window_frames = 0;
+    hud->window_insts = 0;
+    hud->window_core_ms = 0;
+    hud->window_render_ms = 0;
+}
+
+// Top left corner: dimmed panel, text lines, then the frame time graph with a 16.67 ms marker
+void draw_hud(const sdl_t sdl, const hud_t *hud)
+{
+    const int s = hud->scale;
+    const int line_h = (HUD_GLYPH_H + 1) * s;
+    const int graph_h = 20 * s;
+    const int graph_y = s + HUD_LINES * line_h + s;
+    const int width = ((HUD_GLYPH_W + 1) * HUD_LINE_CHARS > HUD_GRAPH_FRAMES ?
+                       (HUD_GLYPH_W + 1) * HUD_LINE_CHARS : HUD_GRAPH_FRAMES) * s + 2 * s;
+
+    SDL_SetRenderDrawBlendMode(sdl.renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(sdl.renderer, 0, 0, 0, 0xC0);
+    SDL_RenderFillRect(sdl.renderer, &(SDL_Rect){0, 0, width, graph_y + graph_h + s});
+    SDL_SetRenderDrawBlendMode(sdl.renderer, SDL_BLENDMODE_NONE);
+
+    uint32_t l, c;
+    for (l = 0; l < HUD_LINES; ++l) {
+        for (c = 0; c < HUD_LINE_CHARS && hud->lines[l][c]; ++c) {
+            int ch = hud->lines[l][c];
+            if (ch >= 'a' && ch <= 'z')
+                ch -= 'a' - 'A';
+            if (ch <= HUD_FIRST_CHAR || ch >= HUD_FIRST_CHAR + HUD_GLYPHS)
+                continue;
+
+            const SDL_Rect src = {(ch - HUD_FIRST_CHAR) * HUD_GLYPH_W, 0, HUD_GLYPH_W, HUD_GLYPH_H};
+            const SDL_Rect dst = {s + c * (HUD_GLYPH_W + 1) * s, s + l * line_h, HUD_GLYPH_W * s, HUD_GLYPH_H * s};
+            SDL_RenderCopy(sdl.renderer, hud->atlas, &src, &dst);
+        }
+    }
+
+    // Oldest frame on the left, frames that missed a slot in red
+    SDL_Rect ok[HUD_GRAPH_FRAMES], slow[HUD_GRAPH_FRAMES];
+    int ok_count = 0, slow_count = 0;
+    uint32_t f;
+    for (f = 0; f < HUD_GRAPH_FRAMES; ++f) {
+        const float ms = hud->frame_ms[(hud->graph_head + f) % HUD_GRAPH_FRAMES];
+        const int h = (int)((ms < HUD_GRAPH_MAX_MS ? ms : HUD_GRAPH_MAX_MS) * graph_h / HUD_GRAPH_MAX_MS);
+        const SDL_Rect bar = {s + f * s, graph_y + graph_h - h, s, h};
+        if (ms >= HUD_DROPPED_MS)
+            slow[slow_count++] = bar;
+        else
+            ok[ok_count++] = bar;
+    }
+    SDL_SetRenderDrawColor(sdl.renderer, 0x40, 0xC0, 0x40, 0xFF);
+    SDL_RenderFillRects(sdl.renderer, ok, ok_count);
+    SDL_SetRenderDrawColor(sdl.renderer, 0xE0, 0x40, 0x40, 0xFF);
+    SDL_RenderFillRects(sdl.renderer, slow, slow_count);
+
+    const int target_y = graph_y + graph_h - (int)(16.67 * graph_h / HUD_GRAPH_MAX_MS);
+    SDL_SetRenderDrawColor(sdl.renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderDrawLine(sdl.renderer, s, target_y, s + HUD_GRAPH_FRAMES * s, target_y);
+}
+
+// Draws into the back buffer, the caller presents it. The pixel fade steps only
+// with advance_fade, so redrawing for the HUD alone leaves the display as it was.
+void update_screen(const sdl_t sdl, const config_t config, const chip8_t *chip8, render_t *render,
+                   const bool advance_fade)
 {
     SDL_Rect rect = {.x = 0, .y = 0, .w = config.scale_factor, .h = config.scale_factor}; 
 
@@ -275,15 +922,15 @@ void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8)
         rect.y = (i / config.window_width) * config.scale_factor;
 
         if (chip8->display[i]) {
-            if (chip8->pixel_color[i] != config.fg_color)
-                chip8->pixel_color[i] = color_lerp(chip8->pixel_color[i], 
+            if (advance_fade && render->pixel_color[i] != config.fg_color)
+                render->pixel_color[i] = color_lerp(render->pixel_color[i], 
                                                     config.fg_color,
                                                     config.color_lerp_rate);
 
-            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
-            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
-            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
-            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
+            const uint8_t r = (render->pixel_color[i] >> 24) & 0xFF;
+            const uint8_t g = (render->pixel_color[i] >> 16) & 0xFF;
+            const uint8_t b = (render->pixel_color[i] >>  8) & 0xFF;
+            const uint8_t a = (render->pixel_color[i] >>  0) & 0xFF;
 
             SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
             SDL_RenderFillRect(sdl.renderer, &rect);
@@ -294,22 +941,48 @@ void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8)
             }
         }
         else {
-            if (chip8->pixel_color[i] != config.bg_color)
-                chip8->pixel_color[i] = color_lerp(chip8->pixel_color[i],
+            if (advance_fade && render->pixel_color[i] != config.bg_color)
+                render->pixel_color[i] = color_lerp(render->pixel_color[i],
                                                     config.bg_color,
                                                     config.color_lerp_rate);
 
-            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
-            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
-            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
-            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
+            const uint8_t r = (render->pixel_color[i] >> 24) & 0xFF;
+            const uint8_t g = (render->pixel_color[i] >> 16) & 0xFF;
+            const uint8_t b = (render->pixel_color[i] >>  8) & 0xFF;
+            const uint8_t a = (render->pixel_color[i] >>  0) & 0xFF;
 
             SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
             SDL_RenderFillRect(sdl.renderer, &rect);
         }
     }
 
-    SDL_RenderPresent(sdl.renderer);
+    if (render->hud.visible)
+        draw_hud(sdl, &render->hud);
+}
+
+#ifdef PROFILE
+// Opcode class table and guest hotspots to stdout, full histograms and
+// collapsed guest call stacks to files in the working directory
+void dump_profile(const chip8_t *chip8)
+{
+    chip8_profile_print(chip8_profile(), stdout);
+    if (chip8_profile_write_csv(chip8_profile(), "chip8_profile.csv"))
+        puts("CHIP8 PROFILE WRITTEN TO chip8_profile.csv");
+
+    chip8_guest_profile_print(chip8->guest_profile, stdout, 20);
+    if (chip8_guest_profile_write_folded(chip8->guest_profile, chip8->rom_name, "chip8_guest.folded"))
+        puts("CHIP8 GUEST CALL STACKS WRITTEN TO chip8_guest.folded");
+}
+#endif
+
+// Reload the current ROM, keeping the profiler and tracer attached by main()
+void reset_chip8(chip8_t *chip8, const chip8_config_t core)
+{
+    chip8_guest_profile_t *guest_profile = chip8->guest_profile;
+    chip8_trace_t *trace = chip8->trace;
+    chip8_init(chip8, core, chip8->rom_name);
+    chip8->guest_profile = guest_profile;
+    chip8->trace = trace;
 }
 
 // CHIP8 Keypad     QWERTY
@@ -317,39 +990,78 @@ void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8)
 // 456D             QWER
 // 789E             ASDF
 // A0BF             ZXCV
-void handle_input(chip8_t *chip8, config_t *config)
+void handle_input(chip8_t *chip8, config_t *config, slot_store_t *slots, bool *rewinding, render_t *render)
 {
     SDL_Event event;
 
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
         case SDL_QUIT:
-            chip8->state = QUIT;
+            chip8->state = CHIP8_QUIT;
             break;
         
         case SDL_KEYDOWN:
             switch (event.key.keysym.sym) {
             case SDLK_ESCAPE:
-                chip8->state = QUIT;
+                chip8->state = CHIP8_QUIT;
                 puts("CHIP8 CLOSED");
                 break;  
             
             case SDLK_SPACE:
-                if (chip8->state == RUNNING) {
-                    chip8->state = PAUSED;
+                if (chip8->state == CHIP8_RUNNING) {
+                    chip8->state = CHIP8_PAUSED;
                     puts("CHIP8 PAUSED");
                 }
                 else {
-                    chip8->state = RUNNING;             
+                    chip8->state = CHIP8_RUNNING;             
                     puts("CHIP8 RUNNING");
                 }
                 break;
 
             case SDLK_n:
                 // '=' Reset CHIP8 machine for the current ROM
-                init_chip8(chip8, *config, chip8->rom_name);
+                reset_chip8(chip8, config->core);
+                memset(render->pixel_color, config->bg_color, sizeof(render->pixel_color));
+                break;
+
+            case SDLK_h:
+                // Toggle the performance HUD, redraw so it disappears when hidden
+                render->hud.visible = !render->hud.visible;
+                chip8->draw = true;
+                break;
+
+            case SDLK_BACKSPACE:
+                // Hold to rewind
+                *rewinding = true;
+                break;
+
+            case SDLK_F1: case SDLK_F2: case SDLK_F3: case SDLK_F4:
+                // Save state to slot 0-3
+                if (save_to_slot(slots, event.key.keysym.sym - SDLK_F1, chip8))
+                    printf("CHIP8 STATE SAVED TO SLOT %d\n", event.key.keysym.sym - SDLK_F1);
                 break;
 
+            case SDLK_F5: case SDLK_F6: case SDLK_F7: case SDLK_F8:
+                // Load state from slot 0-3
+                if (load_from_slot(slots, event.key.keysym.sym - SDLK_F5, chip8))
+                    printf("CHIP8 STATE LOADED FROM SLOT %d\n", event.key.keysym.sym - SDLK_F5);
+                break;
+
+            case SDLK_F9:
+                // Save a checkpoint to the next slot past the hotkey slots, wrapping around
+                if (save_to_slot(slots, slots->next_checkpoint, chip8))
+                    printf("CHIP8 CHECKPOINT SAVED TO SLOT %u\n", slots->next_checkpoint);
+                if (++slots->next_checkpoint >= slots->count)
+                    slots->next_checkpoint = SLOT_HOTKEYS;
+                break;
+
+#ifdef PROFILE
+            case SDLK_F10:
+                // Dump the per-opcode profile so far
+                dump_profile(chip8);
+                break;
+#endif
+
             case SDLK_j:
                 // Decrese color lerp rate
                 if (config->color_lerp_rate > 0.1)
@@ -401,6 +1113,8 @@ void handle_input(chip8_t *chip8, config_t *config)
         
         case SDL_KEYUP:
             switch (event.key.keysym.sym) {
+                case SDLK_BACKSPACE: *rewinding = false; break;
+
                 // Map QWERTY keys to CJIP8 Keypad
                 case SDLK_1: chip8->keypad[0x1] = false; break;
                 case SDLK_2: chip8->keypad[0x2] = false; break;
@@ -432,642 +1146,735 @@ void handle_input(chip8_t *chip8, config_t *config)
     }
 }
 
-#ifdef DEBUG
-void print_debug_info(chip8_t *chip8)
+bool init_timing(timing_t *timing, const config_t config)
 {
-    printf("Address: 0x%04X, Opcode: 0x%04X, Desc: ", 
-            chip8->PC - 2, chip8->inst.opcode);
-    switch ((chip8->inst.opcode >> 12) & 0x0F) {
-    case 0x00:
-        if (chip8->inst.NN == 0xE0) {
-            // 00E0: Clears the screen
-            printf("Clear screen\n");
-        }
-        else if (chip8->inst.NN == 0xEE) {
-            // 00EE: Returns from subrutine
-            printf("Return from subrutine to address: 0x%04X\n",
-                    *(chip8->stack_ptr - 1));
-        }
-        else 
-        {
-            printf("Unimplemented instuction\n");
-        }      
-        break;
-
-    case 0x01:
-        // 1NNN: Jumps to address NNN
-        printf("Jump to address NNN (0x%04X)\n", chip8->inst.NNN);
-        break;
-
-    case 0x02:
-        // 2NNN: Calls subrutine at NNN
-        printf("Call subroutine at NNN (0x%04X)\n", chip8->inst.NNN);
-        break;
-
-    case 0x03:
-        // 3XNN: Skips the next instruction if VX equals NN
-        printf("Check if V%X (0x%02X) == NN (0x%02X), skip next instruction if true\n",
-                chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.NN);
-        break;
-
-    case 0x04:
-        // 4XNN: Skips the next instruction if VX != NN
-        printf("Check if V%X (0x%02X) != NN (0x%02X), skip next instruction if true\n",
-                chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.NN);
-        break;
-
-    case 0x05:
-        // 5XY0: Skips the next instruction if VX == VY
-        printf("Check if V%X (0x%02X) == V%X (0x%02X), skip next instruction if true\n",
-                chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.Y, chip8->V[chip8->inst.Y]);
-        break;
-
-    case 0x06:
-        // 6XNN: Sets VX to NN
-        printf("Set V%X = NN (0x%02X)\n", chip8->inst.X, chip8->inst.NN);
-        break;
-    
-    case 0x07:
-        // 7XNN: Adds NN to VX (carry flag is not changed)
-        printf("Set V%X (0x%02X) += NN (0x%02X), Result: 0x%02X\n", 
-                chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.NN, 
-                chip8->V[chip8->inst.X] + chip8->inst.NN);
-        break;
-
-    case 0x08:
-        switch (chip8->inst.N) {
-        case 0x0:
-            // 8XY0: Sets VX to the value of VY
-            printf("Set register V%X = V%X (0x%02X)\n", 
-                    chip8->inst.X, chip8->inst.Y, chip8->V[chip8->inst.Y]);
-            break;
-        
-        case 0x1:
-            // 8XY1: Sets VX to VX or VY
-                printf("Set register V%X (0x%02X) |= V%X (0x%02X): Result: 0x%02X\n", 
-                        chip8->inst.X, chip8->V[chip8->inst.X],
-                        chip8->inst.Y, chip8->V[chip8->inst.Y],
-                        chip8->V[chip8->inst.X] | chip8->V[chip8->inst.Y]);
-            break;
-        
-        case 0x2:
-            // 8XY2: Sets VX to VX and VY
-            printf("Set register V%X (0x%02X) &= V%X (0x%02X): Result: 0x%02X\n", 
-                        chip8->inst.X, chip8->V[chip8->inst.X],
-                        chip8->inst.Y, chip8->V[chip8->inst.Y],
-                        chip8->V[chip8->inst.X] & chip8->V[chip8->inst.Y]);
-            break;
-        
-        case 0x3:
-            // 8XY3: Sets VX to VX xor VY
-            printf("Set register V%X (0x%02X) ^= V%X (0x%02X): Result: 0x%02X\n", 
-                        chip8->inst.X, chip8->V[chip8->inst.X],
-                        chip8->inst.Y, chip8->V[chip8->inst.Y],
-                        chip8->V[chip8->inst.X] ^ chip8->V[chip8->inst.Y]);
-            break;
-        
-        case 0x4:
-            // 8XY4: Adds VY to VX
-            // VF is set to 1 when there's a carry, and to 0 when there is not 
-            printf("Set register V%X (0x%02X) += V%X (0x%02X), VF = 1 if carry: Result: 0x%02X, VF = %X\n", 
-                        chip8->inst.X, chip8->V[chip8->inst.X],
-                        chip8->inst.Y, chip8->V[chip8->inst.Y],
-                        chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y],
-                        ((uint16_t)chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255);
-            break;
-        
-        case 0x5:
-            // 8XY5: VY is subtracted from VX
-            // VF is set to 0 when there's a borrow, and 1 when there is not
-            printf("Set register V%X (0x%02X) -= V%X (0x%02X), VF = 1 if carry: Result: 0x%02X, VF = %X\n", 
-                    chip8->inst.X, chip8->V[chip8->inst.X],
-                    chip8->inst.Y, chip8->V[chip8->inst.Y],
-                    chip8->V[chip8->inst.X] - chip8->V[chip8->inst.Y],
-                    chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]);
-            break;
-        
-        case 0x6:
-            // 8XY6: Stores the most significant bit of VX in VF
-            // and then shifts VX to the left by 1
-            printf("Set register V%X (0x%02X) >>= 1, VF = shifted off bit (%X): Result: 0x%02X\n", 
-                    chip8->inst.X, chip8->V[chip8->inst.X],
-                    chip8->V[chip8->inst.X] & 1,
-                    chip8->V[chip8->inst.X] >> 1);
-            break;
-        
-        case 0x7:
-            // 8XY7: Sets VX to VY minus VX. VF is set to 0 
-            // when there's a borrow, and 1 when there is not.
-            printf("Set register V%X = V%X (0x%02X) - V%X (0x%02X), VF = 1 if no borrow: Result: 0x%02X, VF = %X\n", 
-                    chip8->inst.X, chip8->inst.Y, chip8->V[chip8->inst.Y],
-                    chip8->inst.X, chip8->V[chip8->inst.X],
-                    chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X],
-                    chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]);
-            break;
-        
-        case 0xE:
-            // 8XYE: Stores the most significant bit of VX in VF 
-            // and then shifts VX to the left by 1.
-            printf("Set register V%X (0x%02X) <<= 1, VF = shifted off bit (%X): Result: 0x%02X\n", 
-                    chip8->inst.X, chip8->V[chip8->inst.X],
-                    (chip8->V[chip8->inst.X] & 0x80) >> 7,
-                    chip8->V[chip8->inst.X] << 1);
-            break;
+    *timing = (timing_t){.origin = SDL_GetPerformanceCounter(), };
+    if (!config.timing_path)
+        return true;
 
-        default:
-            // Wrong or unimplemented opcode
-            break;
+    timing->frames = malloc(TIMING_FRAMES * sizeof(frame_timing_t));
+    if (!timing->frames) {
+        SDL_Log("Could not allocate %d frames of timing history\n", TIMING_FRAMES);
+        return false;
+    }
+    return true;
+}
+
+void begin_phase(timing_t *timing, const frame_phase_t phase)
+{
+    timing->current.phase_start[phase] = SDL_GetPerformanceCounter();
+}
+
+void end_phase(timing_t *timing, const frame_phase_t phase)
+{
+    timing->current.phase_end[phase] = SDL_GetPerformanceCounter();
+}
+
+void begin_frame_timing(timing_t *timing, const uint64_t frame)
+{
+    timing->current = (frame_timing_t){.frame = frame, .start = SDL_GetPerformanceCounter()};
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile rows over the newest count recorded frames, phases that never ran are skipped
+void print_timing_percentiles(const timing_t *timing, const uint64_t count)
+{
+    double *ms = count ? malloc(count * sizeof(double)) : NULL;
+    if (!ms)
+        return;
+
+    printf("Frame timing over %llu frames (ms)  p50      p95      p99      max\n", (long long unsigned)count);
+
+    // Row PHASE_COUNT is the whole frame, PHASE_COUNT + 1 is SDL_Delay oversleep
+    int row;
+    for (row = 0; row < PHASE_COUNT + 2; ++row) {
+        uint64_t n = 0, f;
+        for (f = timing->count - count; f < timing->count; ++f) {
+            const frame_timing_t *t = &timing->frames[f % TIMING_FRAMES];
+            if (row == PHASE_COUNT)
+                ms[n++] = ticks_to_ms(t->end - t->start);
+            else if (row == PHASE_COUNT + 1 && t->phase_start[PHASE_DELAY])
+                ms[n++] = ticks_to_ms(t->phase_end[PHASE_DELAY] - t->phase_start[PHASE_DELAY]) - t->delay_requested_ms;
+            else if (row < PHASE_COUNT && t->phase_start[row])
+                ms[n++] = ticks_to_ms(t->phase_end[row] - t->phase_start[row]);
         }
-        break;
-
-    case 0x09:
-        // 9XY0: Skips the next instruction if VX does not equal VY
-        printf("Check if V%X (0x%02X) != V%X (0x%02X), skip next instruction if true\n",
-                chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.Y, chip8->V[chip8->inst.Y]);
-        break;
-
-    case 0x0A:
-        // ANNN: Sets I to the address NNN
-        printf("Set I to NNN (0x%04X)\n", chip8->inst.NNN);
-        break;
-
-    case 0x0B:
-        // ANNN: Jumps to the address NNN plus V0
-        printf("Set PC to V0 (0x%02X) + NNN (0x%04X): Result: PC = 0x%04X\n",
-                chip8->V[0], chip8->inst.NNN, chip8->V[0] + chip8->inst.NNN);
-        break;
-
-    case 0x0C:
-        // CNNN: Sets VX to the result of a bitwise and 
-        // operation on a random number (Typically: 0 to 255) and NN. 
-        printf("Set V%X = rand() %% 256 & NN (0x%02X)\n",
-                chip8->inst.X, chip8->inst.NN);
-        break;   
-
-     case 0x0D:
-        // DXYN: Draws a sprite at coordinate (VX, VY) that. 
-        // Read from location I.
-        // Screen pixels are XOR'd with sprite bits,
-        // VF (Carry Flag) is set if any screen pixels are set off.
-        printf("Draw N (%u) height sprite at coords V%X (0x%02X), V%X (0x%02X) "
-                "from memory location I (0x%04X). Set VF = 1 if any pixels are turned off.\n",
-                chip8->inst.N, chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.Y, 
-                chip8->V[chip8->inst.Y], chip8->I);
-        break;
-
-    case 0x0E:
-        switch (chip8->inst.NN) {
-        case 0x9E:
-            // EX9E: Skips the next instruction if the key stored in VX is pressed
-            printf("Skip next instruction if key in V%X (0x%02X) is pressed: Keypad value: %d\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X], chip8->keypad[chip8->V[chip8->inst.X]]);
-            break;
-        case 0xA1:
-            // EXA1: Skips the next instruction if the key stored in VX is not pressed
-            printf("Skip next instruction if key in V%X (0x%02X) is not pressed: Keypad value: %d\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X], chip8->keypad[chip8->V[chip8->inst.X]]);
-   
-            break;
-        
-        default:
-            // No opcode
-            break;
+        if (n == 0)
+            continue;
+
+        qsort(ms, n, sizeof(double), compare_doubles);
+        const char *name = row == PHASE_COUNT ? "frame" : row == PHASE_COUNT + 1 ? "SDL_Delay oversleep" : frame_phase_names[row];
+        printf("  %-32s %8.3f %8.3f %8.3f %8.3f\n", name,
+               ms[n / 2], ms[n * 95 / 100], ms[n * 99 / 100], ms[n - 1]);
+    }
+    free(ms);
+}
+
+void end_frame_timing(timing_t *timing)
+{
+    timing->current.end = SDL_GetPerformanceCounter();
+    if (!timing->frames)
+        return;
+    timing->frames[timing->count++ % TIMING_FRAMES] = timing->current;
+
+    if (timing->count % TIMING_WINDOW == 0)
+        print_timing_percentiles(timing, TIMING_WINDOW);
+}
+
+void write_trace_event(FILE *file, const timing_t *timing, const char *name, const uint64_t start, const uint64_t end,
+                       const bool first)
+{
+    fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f",
+            first ? "" : ",", name, ticks_to_ms(start - timing->origin) * 1000, ticks_to_ms(end - start) * 1000);
+}
+
+// Chrome trace-event JSON, opens in chrome://tracing or ui.perfetto.dev. Phases
+// nest under one event per frame; SDL_Delay carries the requested and actual ms.
+bool write_timing_trace(const timing_t *timing, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        SDL_Log("Could not open %s for writing\n", path);
+        return false;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    const uint64_t first = timing->count > TIMING_FRAMES ? timing->count - TIMING_FRAMES : 0;
+    uint64_t f;
+    for (f = first; f < timing->count; ++f) {
+        const frame_timing_t *t = &timing->frames[f % TIMING_FRAMES];
+        write_trace_event(file, timing, "frame", t->start, t->end, f == first);
+        fprintf(file, ",\"args\":{\"frame\":%llu}}", (long long unsigned)t->frame);
+
+        int phase;
+        for (phase = 0; phase < PHASE_COUNT; ++phase) {
+            if (!t->phase_start[phase])
+                continue;
+            write_trace_event(file, timing, frame_phase_names[phase], t->phase_start[phase], t->phase_end[phase], false);
+            if (phase == PHASE_DELAY)
+                fprintf(file, ",\"args\":{\"requested_ms\":%u,\"actual_ms\":%.3f}", t->delay_requested_ms,
+                        ticks_to_ms(t->phase_end[phase] - t->phase_start[phase]));
+            fputc('}', file);
         }
-        break;
-
-    case 0x0F:
-        switch (chip8->inst.NN) {
-        case 0x07:
-            // FX07: Sets VX to the value of the delay timer
-            printf("Set V%X = delay timer value (0x%02X)\n",
-                    chip8->inst.X, chip8->delay_timer);
-            break;
-        
-        case 0x0A:
-            // FX0A: A key press is awaited, and then stored in VX
-            printf("Await until a key is pressed, store key in V%X\n", chip8->inst.X);
-            break;
+    }
+    fputs("\n]}\n", file);
 
-        case 0x15:
-            // FX15: Sets the delay timer to VX
-            printf("Set delay timer value = V%X (0x%02X)\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X]);
-            break;
+    if (fclose(file) != 0) {
+        SDL_Log("Could not write %s\n", path);
+        return false;
+    }
+    return true;
+}
 
-        case 0x18:
-            // FX18: Sets the sound timer to VX
-            printf("Set sound timer value = V%X (0x%02X)\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X]);
-            break;
+// Emulate config.run_ahead_frames frames past the real machine with the current
+// input, present the result, then roll back. The real frame has already run,
+// its timer tick is the first thing the speculative frames do.
+void run_ahead(chip8_t *chip8, chip8_t *backup, const config_t config, const sdl_t sdl,
+               render_t *render, run_ahead_stats_t *stats, timing_t *timing)
+{
+    const uint64_t start = SDL_GetPerformanceCounter();
+    const uint32_t insts_per_frame = config.insts_per_sec / 60;
+
+    begin_phase(timing, PHASE_RUN_AHEAD);
+    *backup = *chip8;
+    // Speculative frames run again for real, keep them out of the profile and trace
+    chip8->guest_profile = NULL;
+    chip8->trace = NULL;
+
+    uint32_t f, i;
+    for (f = 0; f < config.run_ahead_frames; ++f) {
+        chip8_update_timers(chip8);
+        for (i = 0; i < insts_per_frame; ++i)
+            chip8_emulate_instruction(chip8, config.core);
+    }
 
-        case 0x1E:
-            // FX1E: Adds VX to I. VF is not affected.
-            printf("I (0x%04X) += V%X (0x%02X): Result (I): 0x%04X\n",
-                    chip8->I, chip8->inst.X, chip8->V[chip8->inst.X],
-                    chip8->I + chip8->V[chip8->inst.X]);
-            break;
+    end_phase(timing, PHASE_RUN_AHEAD);
 
-        case 0x29:
-            // FX29: Sets I to the location of the sprite for the character in VX.
-            // Characters 0-F (in hexadecimal) are represented by a 4x5 font. 
-            printf("Set I to sprite location in memory for character in V%X (0x%02X). Result (VX * 5) = (0x%02X)\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X], chip8->V[chip8->inst.X] * 5);
-            break;
+    // The fade of what was just shown lives in render and is kept
+    begin_phase(timing, PHASE_RENDER);
+    update_screen(sdl, config, chip8, render, true);
+    end_phase(timing, PHASE_RENDER);
+    begin_phase(timing, PHASE_PRESENT);
+    SDL_RenderPresent(sdl.renderer);
+    end_phase(timing, PHASE_PRESENT);
+    *chip8 = *backup;
+    chip8->draw = false;
+
+    const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000 / SDL_GetPerformanceFrequency();
+    stats->frames++;
+    stats->sum_ms += ms;
+    if (ms > stats->max_ms)
+        stats->max_ms = ms;
+}
 
-        case 0x33:
-            // FX33: Stores the binary-coded decimal representation of VX,
-            // with the hundreds digit in memory at location in I,
-            // the tens digit at location I+1, and the ones digit at location I+2.
-            printf("Store BCD representation of V%X (0x%02X) at memory from I (0x%04X)\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X], chip8->I); 
-            break;
+void print_run_ahead_stats(const run_ahead_stats_t *stats, const config_t config)
+{
+    if (stats->frames == 0)
+        return;
+
+    const double avg_ms = stats->sum_ms / stats->frames;
+    printf("Run-ahead %u frames: avg %.3f ms, max %.3f ms per host frame (%.1f%% of 16.67 ms), "
+           "%.3f ms per speculative frame\n",
+           config.run_ahead_frames, avg_ms, stats->max_ms, avg_ms * 100 / 16.67,
+           avg_ms / config.run_ahead_frames);
+}
 
-        case 0x55:
-            // FX55: Stores from V0 to VX (including VX) in memory, starting at address I.
-            // The offset from I is increased by 1 for each value written,
-            // but I itself is left unmodified (SCHIP).
-            printf("Register dump V0-V%X (0x%02X) inclusive at memory from I (0x%04X)\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X], chip8->I); 
-            break;
+#ifdef BENCH
+// Every timed kernel runs BENCH_WARMUP untimed repetitions, then BENCH_REPS
+// timed ones. The median is reported, min and max show how noisy the run was.
+// All results also go to a JSON file so runs can be diffed across commits.
+#define BENCH_WARMUP    3
+#define BENCH_REPS      11
 
-        case 0x65:
-            // FX65: Fills from V0 to VX (including VX) with values from memory, starting at address I.
-            // The offset from I is increased by 1 for each value read, but I itself is left unmodified
-            printf("Register load V0-V%X (0x%02X) inclusive at memory from I (0x%04X)\n",
-                    chip8->inst.X, chip8->V[chip8->inst.X], chip8->I); 
-            break;
-        
-        default:
-            // No opcode
-            break;
-        }
-        break;
+typedef void (*bench_kernel_t)(void *data, const uint32_t iterations);
 
-    default:
-        printf("Unimplemented instuction\n");
-        break;
+FILE *bench_json;
+uint32_t bench_results;
+
+bool open_bench_json(const char *path)
+{
+    bench_json = fopen(path, "w");
+    if (!bench_json) {
+        SDL_Log("Could not open %s for writing\n", path);
+        return false;
     }
+    fprintf(bench_json, "{\n\"warmup\": %d,\n\"reps\": %d,\n\"chip8_t_bytes\": %zu,\n\"results\": [",
+            BENCH_WARMUP, BENCH_REPS, sizeof(chip8_t));
+    return true;
 }
-#endif
 
-void emulate_instruction(chip8_t *chip8, const config_t config)
+bool close_bench_json(const char *path)
 {
-    bool carry;
-    chip8->inst.opcode = (chip8->ram[chip8->PC] << 8 | chip8->ram[chip8->PC + 1]);
-    chip8->PC += 2;
+    fputs("\n]\n}\n", bench_json);
+    if (fclose(bench_json) != 0) {
+        SDL_Log("Could not write %s\n", path);
+        return false;
+    }
+    printf("%u results written to %s\n", bench_results, path);
+    return true;
+}
 
-    chip8->inst.NNN = chip8->inst.opcode & 0x0FFF;
-    chip8->inst.NN  = chip8->inst.opcode & 0x0FF;
-    chip8->inst.N   = chip8->inst.opcode & 0x0F;
-    chip8->inst.X   = (chip8->inst.opcode >> 8) & 0x0F;
-    chip8->inst.Y   = (chip8->inst.opcode >> 4) & 0x0F;
+void record_bench(const char *name, const char *unit, const double median, const double min, const double max)
+{
+    fprintf(bench_json, "%s\n{\"name\": \"%s\", \"unit\": \"%s\", \"median\": %.4f, \"min\": %.4f, \"max\": %.4f}",
+            bench_results++ ? "," : "", name, unit, median, min, max);
+}
 
-#ifdef DEBUG
-    print_debug_info(chip8);
-#endif
+// Median ns per iteration, printed and recorded under name
+double time_bench(const char *name, bench_kernel_t kernel, void *data, const uint32_t iterations)
+{
+    double ns[BENCH_REPS];
+    uint32_t r;
+    for (r = 0; r < BENCH_WARMUP; ++r)
+        kernel(data, iterations);
+
+    for (r = 0; r < BENCH_REPS; ++r) {
+        const uint64_t start = SDL_GetPerformanceCounter();
+        kernel(data, iterations);
+        ns[r] = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / iterations;
+    }
+    qsort(ns, BENCH_REPS, sizeof(double), compare_doubles);
 
-    switch ((chip8->inst.opcode >> 12) & 0x0F) {
-    case 0x00:
-        if (chip8->inst.NN == 0xE0) {
-            // 0x00E0: Clears the screen
-            memset(chip8->display, 0, sizeof(chip8->display));
-            chip8->draw = true;
-        }
-        else if (chip8->inst.NN == 0xEE) {
-            // 0x00EE: Returns from subrutine
-            chip8->PC = *--chip8->stack_ptr;
-        }
-        else {
-            // Unimplemented/invalid opcode, 0xNNN?
-        }            
-        break;
-    
-    case 0x01:
-        // 1NNN: Jumps to address NNN
-        chip8->PC = chip8->inst.NNN;
-        break;
-
-    case 0x02:
-        // 0x2NNN: Calls subrutine at NNN
-        *chip8->stack_ptr++ = chip8->PC;
-        chip8->PC = chip8->inst.NNN;
-        break;
-    
-    case 0x03:
-        // 3XNN: Skips the next instruction if VX == NN
-        if (chip8->V[chip8->inst.X] == chip8->inst.NN)
-            chip8->PC += 2;
-        break;
-
-    case 0x04:
-        // 4XNN: Skips the next instruction if VX != NN
-        if (chip8->V[chip8->inst.X] != chip8->inst.NN)
-            chip8->PC += 2;
-        break;
-
-    case 0x05:
-        // 5XY0: Skips the next instruction if VX == VY
-        if (chip8->inst.N != 0)
-            break;
-        if (chip8->V[chip8->inst.X] == chip8->V[chip8->inst.Y])
-            chip8->PC += 2;
-        break;
-
-    case 0x06:
-        // 6XNN: Sets VX to NN
-        chip8->V[chip8->inst.X] = chip8->inst.NN;
-        break;
-
-    case 0x07:
-        // 7XNN: Adds NN to VX (carry flag is not changed)
-        chip8->V[chip8->inst.X] += chip8->inst.NN;
-        break;
-
-    case 0x08:
-        switch (chip8->inst.N) {
-        case 0x0:
-            // 8XY0: Sets VX to the value of VY
-            chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y];
-            break;
-        
-        case 0x1:
-            // 8XY1: Sets VX to VX or VY
-            chip8->V[chip8->inst.X] |= chip8->V[chip8->inst.Y];
-            if (config.current_extension == CHIP8)
-                chip8->V[0xF] = 0;
-            break;
-        
-        case 0x2:
-            // 8XY2: Sets VX to VX and VY
-            chip8->V[chip8->inst.X] &= chip8->V[chip8->inst.Y];
-            if (config.current_extension == CHIP8)
-                chip8->V[0xF] = 0;
-            break;
-        
-        case 0x3:
-            // 8XY3: Sets VX to VX xor VY
-            chip8->V[chip8->inst.X] ^= chip8->V[chip8->inst.Y];
-            if (config.current_extension == CHIP8)
-                chip8->V[0xF] = 0;
-            break;
-        
-        case 0x4:
-            // 8XY4: Adds VY to VX
-            // VF is set to 1 when there's a carry, and to 0 when there is not 
-            carry = ((uint16_t)(chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255);
+    printf("%-32s %10.2f ns  (min %.2f, max %.2f)\n", name, ns[BENCH_REPS / 2], ns[0], ns[BENCH_REPS - 1]);
+    record_bench(name, "ns", ns[BENCH_REPS / 2], ns[0], ns[BENCH_REPS - 1]);
+    return ns[BENCH_REPS / 2];
+}
 
-            chip8->V[chip8->inst.X] += chip8->V[chip8->inst.Y];
-            chip8->V[0xF] = carry;
-            break;
-        
-        case 0x5:
-            // 8XY5: VY is subtracted from VX
-            // VF is set to 0 when there's a borrow, and 1 when there is not
-            carry = (chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]);
+typedef struct {
+    chip8_t         chip8;
+    chip8_config_t  config;
+} bench_machine_t;
 
-            chip8->V[chip8->inst.X] -= chip8->V[chip8->inst.Y];
-            chip8->V[0xF] = carry;
-            break;
-        
-        case 0x6:
-            // 8XY6: Stores the most significant bit of VX in VF
-            // and then shifts VX to the left by 1
-            if (config.current_extension == CHIP8) {
-                carry = (chip8->V[chip8->inst.Y] & 1);
-                chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] >> 1;
-            } else {
-                carry = (chip8->V[chip8->inst.X] & 1);
-                chip8->V[chip8->inst.X] >>= 1;
-            }
-            chip8->V[0xF] = carry;
-            break;
-        
-        case 0x7:
-            // 8XY7: Sets VX to VY minus VX. VF is set to 0 
-            // when there's a borrow, and 1 when there is not.
-            carry = (chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]);
-            
-            chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X];
-            chip8->V[0xF] = carry;
-            break;
-        
-        case 0xE:
-            // 8XYE: Stores the most significant bit of VX in VF 
-            // and then shifts VX to the left by 1.
-            if (config.current_extension == CHIP8) {
-                carry = (chip8->V[chip8->inst.Y] & 0x80) >> 7;
-                chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] << 1;
-            } else {
-                carry = (chip8->V[chip8->inst.X] & 0x80) >> 7;
-                chip8->V[chip8->inst.X] <<= 1;
-            }
-            chip8->V[0xF] = carry;
-            break;
+void step_bench_machine(void *data, const uint32_t iterations)
+{
+    bench_machine_t *machine = data;
+    uint32_t i;
+    for (i = 0; i < iterations; ++i)
+        chip8_emulate_instruction(&machine->chip8, machine->config);
+}
 
-        default:
-            // Wrong or unimplemented opcode
-            break;
+// Fill RAM from the entry point with copies of one block of instructions and
+// jump back at the end. With relative set, NNN of each word is an offset from
+// the block start, so jumps and calls just fall through to the next block.
+void load_bench_program(bench_machine_t *machine, const uint16_t *block, const uint32_t words,
+                        const bool relative, const chip8_extension_t extension)
+{
+    static uint8_t rom[CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT];
+    uint32_t addr = CHIP8_ENTRY_POINT, w;
+    for (; addr + words * 2 <= CHIP8_RAM_SIZE - 2; addr += words * 2) {
+        for (w = 0; w < words; ++w) {
+            const uint16_t opcode = relative ? (block[w] & 0xF000) | ((addr + (block[w] & 0xFFF)) & 0xFFF) : block[w];
+            rom[addr - CHIP8_ENTRY_POINT + w * 2] = opcode >> 8;
+            rom[addr - CHIP8_ENTRY_POINT + w * 2 + 1] = opcode & 0xFF;
         }
-        break;
-
-    case 0x09:
-        // 9XY0: Skips the next instruction if VX does not equal VY
-        if (chip8->V[chip8->inst.X] != chip8->V[chip8->inst.Y])
-            chip8->PC += 2;
-        break;
-
-    case 0x0A:
-        // ANNN: Sets I to the address NNN
-        chip8->I = chip8->inst.NNN;
-        break;
-
-    case 0x0B:
-        // BNNN: Jumps to the address NNN plus V0
-        chip8->PC = chip8->V[0] + chip8->inst.NNN;
-        break;
-
-    case 0x0C:
-        // CNNN: Sets VX to the result of a bitwise and 
-        // operation on a random number (Typically: 0 to 255) and NN. 
-        chip8->V[chip8->inst.X] = (rand() % 256) & chip8->inst.NN;
-        break;   
-    
-    case 0x0D:
-        // DXYN: Draws a sprite at coordinate (VX, VY) that. 
-        // Read from location I.
-        // Screen pixels are XOR'd with sprite bits,
-        // VF (Carry Flag) is set if any screen pixels are set off.
-        uint8_t x_coord = chip8->V[chip8->inst.X] % config.window_width;
-        uint8_t y_coord = chip8->V[chip8->inst.Y] % config.window_height;
-        const uint8_t orig_x = x_coord;
-        
-        chip8->V[0xF] = 0;
-
-        // Loop over all N rows of the sprite
-        uint8_t i;
-        int8_t j;
-        for (i = 0; i < chip8->inst.N; ++i) {
-            // Get index row/byte of sprite data
-            const uint8_t sprite_data = chip8->ram[chip8->I + i];
-            x_coord = orig_x; // Reset X for next row to draw
-
-            for (j = 7; j >= 0; --j) {
-                // If sprite pixel/bit is on and display pixel is on, set carry flag
-                bool *pixel = &chip8->display[y_coord * config.window_width + x_coord];
-                const bool sprite_bit = (sprite_data & (1 << j));
-                
-                if (sprite_bit && *pixel) {
-                    chip8->V[0xF] = 1;
-                }
+    }
+    for (; addr < CHIP8_RAM_SIZE; addr += 2) {
+        rom[addr - CHIP8_ENTRY_POINT] = 0x12;
+        rom[addr - CHIP8_ENTRY_POINT + 1] = 0x00;
+    }
 
-                // XOR display pixel with sprite pixel/bit
-                *pixel ^= sprite_bit;
+    machine->config = (chip8_config_t){.current_extension = extension};
+    chip8_init_rom(&machine->chip8, machine->config, rom, sizeof(rom), "bench");
 
-                // Stop drawing if hit right edge of screen
-                if (++x_coord >= config.window_width)
-                    break;
-            }
-            // Stop drawing entire sprite if hit bottom page of screen
-            if (++y_coord >= config.window_height)
-                break;
-        }
-        chip8->draw = true;
-        break;
-
-    case 0x0E:
-        switch (chip8->inst.NN) {
-        case 0x9E:
-            // EX9E: Skips the next instruction if the key stored in VX is pressed
-            if (chip8->keypad[chip8->V[chip8->inst.X]])
-                chip8->PC += 2;
-            break;
-        case 0xA1:
-            // EXA1: Skips the next instruction if the key stored in VX is not pressed
-            if (!chip8->keypad[chip8->V[chip8->inst.X]])
-                chip8->PC += 2;
-            break;
-        
-        default:
-            // No opcode
-            break;
+    // Sprite and load/store data, clear of the program
+    for (w = 0; w < 16; ++w)
+        *chip8_ram_write(&machine->chip8, 0x100 + w) = 0xA5 ^ (w * 0x11);
+    machine->chip8.I = 0x100;
+}
+
+// Decode and dispatch cost of each opcode class. Skips are never taken, so
+// each instruction runs once per pass. FX55/FX65 run with SCHIP semantics so
+// I stays on its data instead of walking into the program.
+void bench_opcodes(void)
+{
+    const struct {
+        const char      *name;
+        uint16_t        block[3];
+        uint32_t        words;
+        bool            relative;
+        chip8_extension_t     extension;
+    } kernels[] = {
+        {"opcode/00E0 cls",         {0x00E0}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/1NNN jp",          {0x1002}, 1, true,  CHIP8_EXT_CHIP8},
+        {"opcode/2NNN+00EE+1NNN",   {0x2004, 0x1006, 0x00EE}, 3, true, CHIP8_EXT_CHIP8},
+        {"opcode/3XNN se",          {0x3001}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/5XY0 se",          {0x5010}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/6XNN ld",          {0x6A55}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/7XNN add",         {0x7A01}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/8XY4 add",         {0x8AB4}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/8XY6 shr",         {0x8AB6}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/ANNN ld i",        {0xA100}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/BNNN jp v0",       {0xB002}, 1, true,  CHIP8_EXT_CHIP8},
+        {"opcode/CXNN rnd",         {0xCAFF}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/EX9E skp",         {0xE09E}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/FX07 ld dt",       {0xFA07}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/FX15 ld dt",       {0xFA15}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/FX1E add i",       {0xF51E}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/FX29 ld f",        {0xF529}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/FX33 bcd",         {0xFA33}, 1, false, CHIP8_EXT_CHIP8},
+        {"opcode/FX55 store v0-vf", {0xFF55}, 1, false, CHIP8_EXT_SUPERCHIP},
+        {"opcode/FX65 load v0-vf",  {0xFF65}, 1, false, CHIP8_EXT_SUPERCHIP},
+    };
+
+    static bench_machine_t machine;
+    uint32_t k;
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        load_bench_program(&machine, kernels[k].block, kernels[k].words, kernels[k].relative, kernels[k].extension);
+        machine.chip8.V[0x1] = 1;       // 5XY0 compares V0 with V1
+        machine.chip8.V[0xA] = 0xC7;    // FX33 has three digits
+        time_bench(kernels[k].name, step_bench_machine, &machine, 200000);
+    }
+}
+
+// DXYN for every sprite height, byte aligned, unaligned and clipped at the right edge
+void bench_dxyn(void)
+{
+    const uint8_t xs[] = {0, 3, 60};
+    static bench_machine_t machine;
+    char name[32];
+
+    uint32_t x, n;
+    for (x = 0; x < sizeof(xs); ++x) {
+        for (n = 1; n <= 15; ++n) {
+            const uint16_t opcode = 0xD010 | n;
+            load_bench_program(&machine, &opcode, 1, false, CHIP8_EXT_CHIP8);
+            machine.chip8.V[0] = xs[x];
+            machine.chip8.V[1] = 8;
+            snprintf(name, sizeof(name), "dxyn/x%u/h%u", xs[x], n);
+            time_bench(name, step_bench_machine, &machine, 20000);
         }
-        break;
+    }
+}
 
-    case 0x0F:
-        switch (chip8->inst.NN) {
-        case 0x07:
-            // FX07: Sets VX to the value of the delay timer
-            chip8->V[chip8->inst.X] = chip8->delay_timer;
-            break;
+typedef struct {
+    render_t    render;
+    config_t    config;
+    chip8_t     chip8;
+    sdl_t       sdl;
+} bench_screen_t;
+
+// One pass fades every pixel one step, alternating towards fg and bg
+void lerp_bench_colors(void *data, const uint32_t iterations)
+{
+    bench_screen_t *screen = data;
+    uint32_t it, i;
+    for (it = 0; it < iterations; ++it) {
+        const uint32_t target = it & 1 ? screen->config.fg_color : screen->config.bg_color;
+        for (i = 0; i < CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT; ++i)
+            screen->render.pixel_color[i] = color_lerp(screen->render.pixel_color[i], target,
+                                                       screen->config.color_lerp_rate);
+    }
+}
 
-        case 0x0A:
-            // FX0A: A key press is awaited, and then stored in VX
-            static bool any_key_pressed = false;
-            static uint8_t key = 0xFF;
-            uint8_t i;
-            for (i = 0; (key == 0xFF) && (i < sizeof(chip8->keypad)); ++i) 
-                if (chip8->keypad[i]) {
-                    key = i;
-                    any_key_pressed = true;
-                    break;
-                }
+void draw_bench_screen(void *data, const uint32_t iterations)
+{
+    bench_screen_t *screen = data;
+    uint32_t i;
+    for (i = 0; i < iterations; ++i)
+        update_screen(screen->sdl, screen->config, &screen->chip8, &screen->render, true);
+}
 
-            // Run the same opcode if no key has been pressed yet
-            if (!any_key_pressed) {
-                chip8->PC -= 2;
-            } else {
-                if (chip8->keypad[key]) {
-                    chip8->PC -= 2;
-                }
-                else {
-                    chip8->V[chip8->inst.X] = key;
-                    key = 0xFF;
-                    any_key_pressed = false;
-                }
-            } 
-            break;
+// update_screen() into SDL's software renderer on a 1:1 surface, so the time
+// is the per-pixel loop and draw calls rather than filling a window
+void bench_render(void)
+{
+    static bench_screen_t screen;
+    set_config_from_args(&screen.config, 0, NULL);
+    screen.config.scale_factor = 1;
+    memset(screen.render.pixel_color, screen.config.bg_color, sizeof(screen.render.pixel_color));
 
-        case 0x15:
-            // FX15: Sets the delay timer to VX
-            chip8->delay_timer = chip8->V[chip8->inst.X];
-            break;
+    uint32_t i;
+    for (i = 0; i < sizeof(screen.chip8.display); ++i)
+        screen.chip8.display[i] = (i * 7 + i / CHIP8_DISPLAY_WIDTH) % 3 == 0;
+
+    time_bench("color_lerp/pixel_color", lerp_bench_colors, &screen, 1000);
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT,
+                                                          32, SDL_PIXELFORMAT_RGBA8888);
+    screen.sdl.renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (!screen.sdl.renderer) {
+        SDL_Log("Could not create software renderer %s\n", SDL_GetError());
+        SDL_FreeSurface(surface);
+        return;
+    }
 
-        case 0x18:
-            // FX18: Sets the sound timer to VX
-            chip8->sound_timer = chip8->V[chip8->inst.X];
-            break;
+    time_bench("update_screen/software", draw_bench_screen, &screen, 200);
+    screen.config.pixel_outlines = false;
+    time_bench("update_screen/software/no outlines", draw_bench_screen, &screen, 200);
 
-        case 0x1E:
-            // FX1E: Adds VX to I. VF is not affected.
-            chip8->I += chip8->V[chip8->inst.X];
-            break;
+    SDL_DestroyRenderer(screen.sdl.renderer);
+    SDL_FreeSurface(surface);
+}
 
-        case 0x29:
-            // FX29: Sets I to the location of the sprite for the character in VX.
-            // Characters 0-F (in hexadecimal) are represented by a 4x5 font. 
-            chip8->I = chip8->V[chip8->inst.X] * 5;
-            break;
+void fill_bench_audio(void *data, const uint32_t iterations)
+{
+    int16_t buffer[512];
+    uint32_t i;
+    for (i = 0; i < iterations; ++i)
+        audio_callback(data, (uint8_t *)buffer, sizeof(buffer));
+}
 
-        case 0x33:
-            // FX33: Stores the binary-coded decimal representation of VX,
-            // with the hundreds digit in memory at location in I,
-            // the tens digit at location I+1, and the ones digit at location I+2. 
-            uint8_t bcd = chip8->V[chip8->inst.X];
-            chip8->ram[chip8->I + 2] = bcd % 10;
-            bcd /= 10;
-            chip8->ram[chip8->I + 1] = bcd % 10;
-            bcd /= 10;
-            chip8->ram[chip8->I + 0] = bcd;
-            break;
+// audio_callback() per 512 sample buffer for both waveform generators
+void bench_audio_callback(void)
+{
+    const chip8_extension_t extensions[] = {CHIP8_EXT_CHIP8, CHIP8_EXT_XOCHIP};
+    const char *names[] = {"audio_callback/square", "audio_callback/xochip"};
+
+    uint32_t e;
+    for (e = 0; e < sizeof(extensions) / sizeof(extensions[0]); ++e) {
+        config_t config = {0};
+        set_config_from_args(&config, 0, NULL);
+        config.core.current_extension = extensions[e];
+
+        audio_t audio;
+        init_audio(&audio, &config);
+        audio.sample_rate = 44100;
+        audio.buffer_samples = 512;
+        chip8_audio_init(&audio.synth, audio.sample_rate, config.square_wave_freq, config.volume,
+                         config.core.current_extension);
+        audio.synth.gate = true;
+
+        chip8_t chip8 = {0};
+        memset(chip8.audio_pattern, 0xF0, sizeof(chip8.audio_pattern));
+        chip8.pitch = 64;
+        publish_audio_pattern(&audio, &chip8);
+
+        const double ns_per_buffer = time_bench(names[e], fill_bench_audio, &audio, 2000);
+        printf("%-32s %10.4f%% of realtime\n", "", ns_per_buffer * 100 / (512 * 1e9 / audio.sample_rate));
+    }
+}
 
-        case 0x55:
-            // FX55: Stores from V0 to VX (including VX) in memory, starting at address I.
-            // The offset from I is increased by 1 for each value written, but I itself is left unmodified.
-            // CHIP8 does increment I, SCHIP does not increment I.
-            for (i = 0; i <= chip8->inst.X; ++i)                
-                if (config.current_extension == CHIP8)
-                    chip8->ram[chip8->I++] = chip8->V[i];
-                else 
-                    chip8->ram[chip8->I + i] = chip8->V[i];
-                
-            break;
+// Calls, key skips, FX55/FX65 and DXYN
+static const uint8_t bench_core_program[] = {
+    0xA3, 0x00,     // 200: LD I, 0x300
+    0x22, 0x10,     // 202: CALL 0x210
+    0x70, 0x01,     // 204: ADD V0, 1
+    0x61, 0x05,     // 206: LD V1, 5
+    0xE1, 0xA1,     // 208: SKNP V1
+    0x72, 0x01,     // 20A: ADD V2, 1
+    0x12, 0x00,     // 20C: JP 0x200
+    0x00, 0x00,
+    0xF3, 0x55,     // 210: LD [I], V3
+    0xF3, 0x65,     // 212: LD V3, [I]
+    0xD0, 0x11,     // 214: DRW V0, V1, 1
+    0x00, 0xEE,     // 216: RET
+};
+
+// The same core built with -DCHIP8_UNCHECKED, its other symbols kept local
+void chip8_emulate_unchecked(chip8_t *chip8, const chip8_config_t config);
+
+void step_unchecked_machine(void *data, const uint32_t iterations)
+{
+    bench_machine_t *machine = data;
+    uint32_t i;
+    for (i = 0; i < iterations; ++i)
+        chip8_emulate_unchecked(&machine->chip8, machine->config);
+}
 
-        case 0x65:
-            // FX65: Fills from V0 to VX (including VX) with values from memory, starting at address I.
-            // The offset from I is increased by 1 for each value read, but I itself is left unmodified.
-            // CHIP8 does increment I, SCHIP does not increment I.
-            for (i = 0; i <= chip8->inst.X; ++i)
-                if (config.current_extension == CHIP8)
-                    chip8->V[i] = chip8->ram[chip8->I++];
-                else
-                    chip8->V[i] = chip8->ram[chip8->I + i];
-                
-            break;
-        
-        default:
-            break;
+// The masked accesses, 2NNN/00EE, EXA1, FX55/FX65, DXYN and the RAM page index
+// of every fetch, read and write, against the same core without the masks.
+// The program keeps every index in range so both builds run identical instructions.
+void bench_core(void)
+{
+    config_t config = {0};
+    set_config_from_args(&config, 0, NULL);
+
+    static bench_machine_t checked, unchecked;
+    checked.config = unchecked.config = config.core;
+    if (!chip8_init_rom(&checked.chip8, config.core, bench_core_program, sizeof(bench_core_program), "bench") ||
+        !chip8_init_rom(&unchecked.chip8, config.core, bench_core_program, sizeof(bench_core_program), "bench"))
+        return;
+
+    const double masked_ns = time_bench("emulate_instruction/mix", step_bench_machine, &checked, 1000000);
+    const double unchecked_ns = time_bench("emulate_instruction/mix/unchecked", step_unchecked_machine,
+                                           &unchecked, 1000000);
+    printf("emulate_instruction %8.1f M instructions/s masked, %.1f unchecked (%+.1f%%)\n",
+           1e3 / masked_ns, 1e3 / unchecked_ns, (masked_ns / unchecked_ns - 1) * 100);
+}
+
+// Machines for the interleave and SoA kernels. iterations counts instructions
+// over the whole group, each machine runs iterations / count of them.
+typedef struct {
+    chip8_t         **machines;
+    uint32_t        count;
+    chip8_config_t  config;
+    chip8_soa_t     *soa;
+} bench_group_t;
+
+void step_round_robin(void *data, const uint32_t iterations)
+{
+    bench_group_t *group = data;
+    const uint32_t steps = iterations / group->count;
+    uint32_t s, i;
+    for (s = 0; s < steps; ++s)
+        for (i = 0; i < group->count; ++i)
+            chip8_emulate_instruction(group->machines[i], group->config);
+}
+
+void step_one_by_one(void *data, const uint32_t iterations)
+{
+    bench_group_t *group = data;
+    const uint32_t steps = iterations / group->count;
+    uint32_t s, i;
+    for (i = 0; i < group->count; ++i)
+        for (s = 0; s < steps; ++s)
+            chip8_emulate_instruction(group->machines[i], group->config);
+}
+
+void step_soa_lanes(void *data, const uint32_t iterations)
+{
+    bench_group_t *group = data;
+    uint32_t i;
+    for (i = 0; i < group->count; i += CHIP8_SOA_LANES) {
+        chip8_soa_load(group->soa, &group->machines[i], group->count - i);
+        chip8_soa_run(group->soa, group->config, iterations / group->count);
+        chip8_soa_store(group->soa);
+    }
+}
+
+// Step many forks round robin, one instruction each, as a batch or environment
+// host does. Throughput falls once the machines no longer fit in cache, so
+// this shows how many cache lines each machine touches per instruction.
+void bench_interleave(void)
+{
+    const uint32_t counts[] = {64, 1024, 4096, 16384};
+    const uint32_t instructions = 1 << 20;
+
+    config_t config = {0};
+    set_config_from_args(&config, 0, NULL);
+
+    static chip8_t root;
+    if (!chip8_init_rom(&root, config.core, bench_core_program, sizeof(bench_core_program), "bench"))
+        return;
+
+    uint32_t c, i;
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        chip8_pool_t pool;
+        chip8_t **machines = malloc(counts[c] * sizeof(chip8_t *));
+        if (!machines || !chip8_pool_init(&pool, &root, counts[c])) {
+            free(machines);
+            return;
         }
-        break;
+        for (i = 0; i < counts[c]; ++i)
+            machines[i] = chip8_fork(&pool, &root);
+
+        bench_group_t group = {.machines = machines, .count = counts[c], .config = config.core};
+        char name[32];
+        snprintf(name, sizeof(name), "interleaved/%u", counts[c]);
+        const double ns = time_bench(name, step_round_robin, &group, instructions);
+        printf("interleaved %6u machines %8.1f M instructions/s, %zu byte machines\n",
+               counts[c], 1e3 / ns, sizeof(chip8_t));
+        chip8_pool_free(&pool);
+        free(machines);
+    }
+}
+
+typedef struct {
+    chip8_pool_t    *pool;
+    chip8_t         *root;
+    chip8_t         **forks;
+    uint32_t        capacity;
+} bench_fork_t;
+
+// Fork and release iterations machines, a pool full at a time
+void fork_and_release(void *data, const uint32_t iterations)
+{
+    bench_fork_t *bench = data;
+    uint32_t done, i;
+    for (done = 0; done < iterations; done += bench->capacity) {
+        for (i = 0; i < bench->capacity; ++i)
+            bench->forks[i] = chip8_fork(bench->pool, bench->root);
+        for (i = 0; i < bench->capacity; ++i)
+            chip8_pool_release(bench->pool, bench->forks[i]);
+    }
+}
+
+// Fork a machine that has dirtied one RAM page and release the forks again
+void bench_fork(void)
+{
+    const uint32_t capacity = 1024;
+    // 0x200: LD I, 0x300; LD V0, 1; ADD V0, 1; LD [I], V0; JP 0x204
+    const uint8_t program[] = {0xA3, 0x00, 0x60, 0x01, 0x70, 0x01, 0xF0, 0x55, 0x12, 0x04};
 
-    default:
-        break; // Unimplemented instuction
+    config_t config = {0};
+    set_config_from_args(&config, 0, NULL);
+
+    static uint8_t ram[CHIP8_RAM_SIZE];
+    memcpy(&ram[0x200], program, sizeof(program));
+
+    chip8_t *root = chip8_alloc(1);
+    chip8_pool_t *pool = malloc(sizeof(chip8_pool_t));
+    chip8_t **forks = malloc(capacity * sizeof(chip8_t *));
+    if (!root || !pool || !forks) {
+        chip8_free(root);
+        free(pool);
+        free(forks);
+        return;
     }
+    chip8_load_ram(root, ram);
+    root->PC = 0x200;
+    if (!chip8_pool_init(pool, root, capacity)) {
+        chip8_free(root);
+        free(pool);
+        free(forks);
+        return;
+    }
+
+    // Dirty the page at 0x300 so every fork copies one private page
+    uint32_t i;
+    for (i = 0; i < 4; ++i)
+        chip8_emulate_instruction(root, config.core);
+
+    bench_fork_t bench = {.pool = pool, .root = root, .forks = forks, .capacity = capacity};
+    const double ns = time_bench("chip8_fork/release", fork_and_release, &bench, capacity * 64);
+    const size_t per_fork = offsetof(chip8_t, ram_private) +
+                            __builtin_popcount(root->ram_private_mask) * CHIP8_RAM_PAGE_SIZE;
+    printf("chip8_fork %12.0f forks/s with release, %zu bytes copied per fork (%u private pages), "
+           "%zu byte slot vs %zu byte full copy\n",
+           1e9 / ns, per_fork, __builtin_popcount(root->ram_private_mask), sizeof(chip8_t),
+           offsetof(chip8_t, ram_private) + (size_t)CHIP8_RAM_SIZE);
+
+    free(forks);
+    chip8_pool_free(pool);
+    free(pool);
+    chip8_free(root);
 }
 
-void update_timers(const sdl_t sdl, chip8_t *chip8)
+// Aggregate instructions/s over many instances of one ROM, scalar against the
+// SoA lane core. CXNN makes lanes take different branches, DXYN runs on a
+// quarter of the iterations and goes through the scalar fallback.
+void bench_soa(void)
 {
-    if (chip8->delay_timer > 0)
-        chip8->delay_timer--;
-    if (chip8->sound_timer > 0) {
-        chip8->sound_timer--;
-        SDL_PauseAudioDevice(sdl.dev, 0);
-    } else {
-        SDL_PauseAudioDevice(sdl.dev, 1);
+    enum { instances = 512 };
+    const uint32_t steps = 2000;    // Per machine and repetition
+    const uint8_t program[] = {
+        0xA2, 0x30,     // 200: LD I, 0x230
+        0xC0, 0x03,     // 202: RND V0, 3
+        0x71, 0x01,     // 204: ADD V1, 1
+        0x82, 0x14,     // 206: ADD V2, V1
+        0x83, 0x20,     // 208: LD V3, V2
+        0x83, 0x36,     // 20A: SHR V3, V3
+        0x84, 0x35,     // 20C: SUB V4, V3
+        0x30, 0x00,     // 20E: SE V0, 0
+        0x12, 0x18,     // 210: JP 0x218
+        0x85, 0x0E,     // 212: SHL V5, V0
+        0xF5, 0x1E,     // 214: ADD I, V5
+        0xA2, 0x30,     // 216: LD I, 0x230
+        0x40, 0x01,     // 218: SNE V0, 1
+        0xD0, 0x11,     // 21A: DRW V0, V1, 1
+        0x12, 0x02,     // 21C: JP 0x202
+    };
+
+    config_t config = {0};
+    set_config_from_args(&config, 0, NULL);
+
+    static uint8_t ram[CHIP8_RAM_SIZE];
+    memcpy(&ram[0x200], program, sizeof(program));
+    ram[0x230] = 0x80;
+
+    // Bench only runs once, keep the large state out of the stack
+    static chip8_t root;
+    static chip8_pool_t pool;
+    static chip8_soa_t soa;
+    static chip8_t *scalar[instances], *lanes[instances];
+
+    chip8_load_ram(&root, ram);
+    root.PC = 0x200;
+    if (!chip8_pool_init(&pool, &root, instances * 2))
+        return;
+
+    uint32_t i;
+    for (i = 0; i < instances; ++i) {
+        root.rng_state = i * 0x9E3779B97F4A7C15ull;
+        scalar[i] = chip8_fork(&pool, &root);
+        lanes[i] = chip8_fork(&pool, &root);
     }
+
+    // Both run the same number of steps per machine across warm-up and reps
+    bench_group_t scalar_group = {.machines = scalar, .count = instances, .config = config.core};
+    bench_group_t soa_group = {.machines = lanes, .count = instances, .config = config.core, .soa = &soa};
+    const double scalar_ns = time_bench("soa/scalar", step_one_by_one, &scalar_group, instances * steps);
+    const double soa_ns = time_bench("soa/lanes", step_soa_lanes, &soa_group, instances * steps);
+
+    // Both cores must end in the same state
+    uint8_t a[CHIP8_STATE_SIZE], b[CHIP8_STATE_SIZE];
+    uint32_t mismatches = 0;
+    for (i = 0; i < instances; ++i) {
+        chip8_save_state(scalar[i], a);
+        chip8_save_state(lanes[i], b);
+        mismatches += memcmp(a, b, sizeof(a)) != 0;
+    }
+
+    printf("emulate_instruction %8.1f M instructions/s over %u instances\n", 1e3 / scalar_ns, instances);
+    printf("chip8_soa_run       %8.1f M instructions/s, %u lanes, %.2fx scalar, %u mismatches\n",
+           1e3 / soa_ns, CHIP8_SOA_LANES, scalar_ns / soa_ns, mismatches);
+
+    chip8_pool_free(&pool);
 }
+#endif
 
 int main(int argc, char **argv)
 {
+#ifdef BENCH
+    // chip8_bench [results.json]
+    const char *json_path = argc > 1 ? argv[1] : "chip8_bench.json";
+    if (!open_bench_json(json_path))
+        exit(EXIT_FAILURE);
+    bench_opcodes();
+    bench_dxyn();
+    bench_render();
+    bench_audio_callback();
+    bench_core();
+    bench_interleave();
+    bench_fork();
+    bench_soa();
+    exit(close_bench_json(json_path) ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
+
     if (argc < 2) {
         fprintf(stderr, "Usage: %s <rom_name>\n", argv[0]);
         exit(EXIT_FAILURE);
@@ -1077,50 +1884,176 @@ int main(int argc, char **argv)
     if (!set_config_from_args(&config, argc, argv))
         exit(EXIT_FAILURE);
 
+    // Initialize audio engine, shared with the SDL audio callback
+    audio_t audio;
+    init_audio(&audio, &config);
+
     // Initialize SDL
     sdl_t sdl = {0};
-    if (!init_sdl(&sdl, &config))
+    if (!init_sdl(&sdl, &config, &audio))
         exit(EXIT_FAILURE);
 
     chip8_t chip8 = {0};
     const char *rom_name = argv[1];
-    if (!init_chip8(&chip8, config, rom_name))
+    if (!chip8_init(&chip8, config.core, rom_name))
+        exit(EXIT_FAILURE);
+    render_t render = {0};
+    memset(render.pixel_color, config.bg_color, sizeof(render.pixel_color));
+#ifdef PROFILE
+    static chip8_guest_profile_t guest_profile;
+    chip8_guest_profile_init(&guest_profile);
+    chip8.guest_profile = &guest_profile;
+#endif
+#ifdef DEBUG
+    // The newest 1M instructions, written to chip8.trace on exit for chip8-trace
+    chip8_trace_t trace;
+    if (!chip8_trace_init(&trace, 1 << 20))
         exit(EXIT_FAILURE);
+    chip8.trace = &trace;
+#endif
 
     // Initial screen clear
     clear_screen(sdl, config);
+    if (!init_hud(&render.hud, sdl, config))
+        exit(EXIT_FAILURE);
+
+    printf("CHIP8 SEED %llu\n", (long long unsigned)config.core.seed);
 
-    srand(time(NULL));
+    uint64_t frame = 0; // Emulated 60 Hz ticks, timestamps sound edges
+
+    // Savestate slots, F1-F4 save, F5-F8 load, F9 saves a checkpoint
+    slot_store_t slots;
+    if (!open_slot_store(&slots, config.slots_path, config.slot_count))
+        exit(EXIT_FAILURE);
+
+    if (config.load_slot >= 0 && !load_from_slot(&slots, config.load_slot, &chip8)) {
+        SDL_Log("Slot %d does not hold a valid savestate\n", config.load_slot);
+        exit(EXIT_FAILURE);
+    }
+
+    // Hold backspace to step back through recent frames
+    chip8_rewind_t *rewind = chip8_rewind_create(config.rewind_budget_mb);
+    if (!rewind)
+        exit(EXIT_FAILURE);
+    bool rewinding = false;
+    
+    // Snapshot of the real machine while run-ahead frames are on screen
+    chip8_t *run_ahead_backup = chip8_alloc(1);
+    run_ahead_stats_t run_ahead_stats = {0};
+    if (!run_ahead_backup)
+        exit(EXIT_FAILURE);
+
+    // Per-frame phase timings, --timing
+    timing_t timing;
+    if (!init_timing(&timing, config))
+        exit(EXIT_FAILURE);
     
     // Main loop
-    while (chip8.state != QUIT) {
-        handle_input(&chip8, &config);
+    while (chip8.state != CHIP8_QUIT) {
+        begin_frame_timing(&timing, frame);
+        begin_phase(&timing, PHASE_INPUT);
+        handle_input(&chip8, &config, &slots, &rewinding, &render);
+        end_phase(&timing, PHASE_INPUT);
 
-        if (chip8.state == PAUSED)
+        if (chip8.state == CHIP8_PAUSED && !rewinding)
             continue;
 
         const uint64_t start_frame_time = SDL_GetPerformanceCounter();
 
+        const uint32_t insts_per_frame = config.insts_per_sec / 60;
         uint32_t i;
-        for (i = 0; i < config.insts_per_sec / 60; ++i)
-            emulate_instruction(&chip8, config);
+        begin_phase(&timing, PHASE_EMULATE);
+        if (rewinding && chip8_rewind_step(rewind, &chip8)) {
+            publish_audio_pattern(&audio, &chip8);
+            chip8.audio_changed = false;
+        }
+
+        for (i = 0; !rewinding && i < insts_per_frame; ++i) {
+            chip8_emulate_instruction(&chip8, config.core);
+
+            if (chip8.audio_changed) {
+                publish_audio_pattern(&audio, &chip8);
+                chip8.audio_changed = false;
+            }
+
+            if ((chip8.sound_timer > 0) != audio.sound_on)
+                push_sound_edge(&audio, chip8.sound_timer > 0,
+                                chip8_audio_sample_time(audio.sample_rate, frame, i + 1, insts_per_frame));
+        }
+        end_phase(&timing, PHASE_EMULATE);
+
+        // Present a speculative future frame, its cost counts against this frame's budget
+        const bool running_ahead = config.run_ahead_frames && !rewinding;
+        if (running_ahead)
+            run_ahead(&chip8, run_ahead_backup, config, sdl, &render, &run_ahead_stats, &timing);
 
         const uint64_t end_frame_time = SDL_GetPerformanceCounter();
         
         const double time_elapsed = (double)((end_frame_time - start_frame_time) * 1000) / SDL_GetPerformanceFrequency();
 
-        SDL_Delay(16.67f > time_elapsed ? 16.67f - time_elapsed : 0);
-
-        if (chip8.draw) {
-            update_screen(sdl, config, &chip8);
+        timing.current.delay_requested_ms = 16.67f > time_elapsed ? 16.67f - time_elapsed : 0;
+        begin_phase(&timing, PHASE_DELAY);
+        SDL_Delay(timing.current.delay_requested_ms);
+        end_phase(&timing, PHASE_DELAY);
+
+        // The HUD changes every frame even when the display does not
+        if (chip8.draw || render.hud.visible) {
+            if (!running_ahead) {
+                begin_phase(&timing, PHASE_RENDER);
+                update_screen(sdl, config, &chip8, &render, chip8.draw);
+                end_phase(&timing, PHASE_RENDER);
+                begin_phase(&timing, PHASE_PRESENT);
+                SDL_RenderPresent(sdl.renderer);
+                end_phase(&timing, PHASE_PRESENT);
+            }
             chip8.draw = false;
         }
 
-        update_timers(sdl, &chip8);
+        if (!rewinding) {
+            begin_phase(&timing, PHASE_TIMERS);
+            chip8_update_timers(&chip8);
+            end_phase(&timing, PHASE_TIMERS);
+            chip8_rewind_capture(rewind, &chip8);
+        }
+        ++frame;
+
+        // Sound timer ran out on this tick
+        if ((chip8.sound_timer > 0) != audio.sound_on)
+            push_sound_edge(&audio, chip8.sound_timer > 0,
+                            chip8_audio_sample_time(audio.sample_rate, frame, 0, insts_per_frame));
+
+        if (config.max_frames && frame >= config.max_frames)
+            chip8.state = CHIP8_QUIT;
+
+        end_frame_timing(&timing);
+        record_hud_frame(&render.hud, &timing.current, rewinding ? 0 : insts_per_frame, &audio);
     }
 
     // Final cleanup
+    SDL_DestroyTexture(render.hud.atlas);
     final_cleanup(sdl);
+    print_audio_latency(&audio);
+
+    print_run_ahead_stats(&run_ahead_stats, config);
+    if (timing.frames) {
+        print_timing_percentiles(&timing, timing.count < TIMING_FRAMES ? timing.count : TIMING_FRAMES);
+        if (write_timing_trace(&timing, config.timing_path))
+            printf("Frame timing trace written to %s\n", config.timing_path);
+        free(timing.frames);
+    }
+#ifdef PROFILE
+    dump_profile(&chip8);
+#endif
+#ifdef DEBUG
+    if (chip8_trace_write(&trace, "chip8.trace"))
+        puts("CHIP8 TRACE WRITTEN TO chip8.trace");
+    chip8_trace_free(&trace);
+#endif
+
+    close_slot_store(&slots);
+
+    chip8_rewind_free(rewind);
+    chip8_free(run_ahead_backup);
 
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
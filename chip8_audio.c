@@ -0,0 +1,168 @@
+#include <math.h>
+#include <string.h>
+#include "chip8_audio.h"
+
+static void init_kernel(chip8_audio_t *audio)
+{
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9; // Fraction of output Nyquist kept
+    const double half = CHIP8_AUDIO_KERNEL_TAPS / 2;
+
+    uint32_t p, k;
+    for (p = 0; p < CHIP8_AUDIO_KERNEL_PHASES; ++p) {
+        const double frac = (double)p / CHIP8_AUDIO_KERNEL_PHASES;
+        double sum = 0;
+
+        for (k = 0; k < CHIP8_AUDIO_KERNEL_TAPS; ++k) {
+            // Distance from the impulse, which sits half the kernel in
+            const double x = k - half - frac + 1;
+            const double sinc = (x == 0) ? 1 : sin(pi * cutoff * x) / (pi * cutoff * x);
+            // Blackman window over [-half, half]
+            const double w = (x <= -half || x >= half) ? 0 :
+                             0.42 + 0.5 * cos(pi * x / half) + 0.08 * cos(2 * pi * x / half);
+
+            audio->kernel[p][k] = sinc * w;
+            sum += sinc * w;
+        }
+
+        for (k = 0; k < CHIP8_AUDIO_KERNEL_TAPS; ++k)
+            audio->kernel[p][k] /= sum;
+    }
+}
+
+void chip8_audio_init(chip8_audio_t *audio, const uint32_t sample_rate, const uint32_t square_wave_freq,
+                      const int16_t volume, const chip8_extension_t extension)
+{
+    *audio = (chip8_audio_t) {
+        .sample_rate        = sample_rate,
+        .square_wave_freq   = square_wave_freq,
+        .volume             = volume,
+        .xochip             = extension == CHIP8_EXT_XOCHIP,
+        .level              = -1.0f,
+    };
+    init_kernel(audio);
+
+    const uint8_t pattern[16] = {0};
+    chip8_audio_set_pattern(audio, pattern, 64);
+}
+
+void chip8_audio_set_pattern(chip8_audio_t *audio, const uint8_t pattern[16], const uint8_t pitch)
+{
+    memcpy(audio->pattern, pattern, sizeof(audio->pattern));
+    if (pitch != audio->pitch || audio->bit_period == 0) {
+        audio->pitch = pitch;
+        audio->bit_period = audio->sample_rate / (4000.0 * pow(2.0, (pitch - 64) / 48.0));
+    }
+}
+
+uint64_t chip8_audio_sample_time(const uint32_t sample_rate, const uint64_t frame,
+                                 const uint32_t inst, const uint32_t insts_per_frame)
+{
+    return ((frame * insts_per_frame + inst) * sample_rate) / (60ull * insts_per_frame);
+}
+
+// Spread a level change at fractional sample time t over the kernel taps
+static void add_delta(chip8_audio_t *audio, const double t, const float delta)
+{
+    const uint32_t i = (uint32_t)t;
+    const uint32_t phase = (uint32_t)((t - i) * CHIP8_AUDIO_KERNEL_PHASES);
+    const float *kernel = audio->kernel[phase];
+    float *out = &audio->delta_buf[i];
+
+    uint32_t k;
+    for (k = 0; k < CHIP8_AUDIO_KERNEL_TAPS; ++k)
+        out[k] += delta * kernel[k];
+}
+
+// Resample the XO-CHIP pattern to the output rate
+static void render_pattern(chip8_audio_t *audio, int16_t *out, const uint32_t num_samples)
+{
+    uint32_t done = 0;
+
+    while (done < num_samples) {
+        const uint32_t chunk = (num_samples - done < CHIP8_AUDIO_CHUNK) ? num_samples - done : CHIP8_AUDIO_CHUNK;
+
+        // Emit a band-limited step for every bit edge inside this chunk
+        while (audio->next_edge < chunk) {
+            const bool bit = (audio->pattern[audio->bit_index >> 3] >> (7 - (audio->bit_index & 7))) & 1;
+            if (bit != audio->bit) {
+                add_delta(audio, audio->next_edge, bit ? 2.0f : -2.0f);
+                audio->bit = bit;
+            }
+            audio->bit_index = (audio->bit_index + 1) & 0x7F;
+            audio->next_edge += audio->bit_period;
+        }
+        audio->next_edge -= chunk;
+
+        // Integrate deltas back into levels
+        uint32_t i;
+        for (i = 0; i < chunk; ++i) {
+            audio->level += audio->delta_buf[i];
+            const float sample = audio->level * audio->volume;
+            out[done + i] = (sample > INT16_MAX) ? INT16_MAX :
+                            (sample < INT16_MIN) ? INT16_MIN : (int16_t)sample;
+        }
+
+        // Carry the kernel tails into the next chunk
+        memmove(audio->delta_buf, &audio->delta_buf[chunk], CHIP8_AUDIO_KERNEL_TAPS * sizeof(float));
+        memset(&audio->delta_buf[CHIP8_AUDIO_KERNEL_TAPS], 0, chunk * sizeof(float));
+
+        done += chunk;
+    }
+}
+
+// Polynomial band-limited step correction for an edge at phase 0,
+// t is the oscillator phase in [0, 1), dt the phase increment per sample
+static float poly_blep(float t, const float dt, const float inv_dt)
+{
+    if (t < dt) {
+        t *= inv_dt;
+        return t + t - t * t - 1.0f;
+    }
+    if (t > 1.0f - dt) {
+        t = (t - 1.0f) * inv_dt;
+        return t * t + t + t + 1.0f;
+    }
+    return 0.0f;
+}
+
+// Band-limited square wave at square_wave_freq, phase continuous across calls
+static void render_square_wave(chip8_audio_t *audio, int16_t *out, const uint32_t num_samples)
+{
+    const float dt = (float)audio->square_wave_freq / audio->sample_rate;
+    const float inv_dt = 1.0f / dt;
+    float phase = audio->square_phase;
+
+    uint32_t i;
+    for (i = 0; i < num_samples; ++i) {
+        // Low half of the period first, matching the original naive square wave
+        float half_phase = phase + 0.5f;
+        if (half_phase >= 1.0f)
+            half_phase -= 1.0f;
+
+        float sample = (phase < 0.5f) ? -1.0f : 1.0f;
+        sample -= poly_blep(phase, dt, inv_dt);
+        sample += poly_blep(half_phase, dt, inv_dt);
+
+        out[i] = (int16_t)(sample * audio->volume);
+
+        phase += dt;
+        if (phase >= 1.0f)
+            phase -= 1.0f;
+    }
+
+    audio->square_phase = phase;
+}
+
+void chip8_audio_render(chip8_audio_t *audio, int16_t *out, const uint32_t num_samples)
+{
+    if (num_samples == 0)
+        return;
+
+    if (!audio->gate)
+        memset(out, 0, num_samples * sizeof(int16_t));
+    else if (audio->xochip)
+        render_pattern(audio, out, num_samples);
+    else
+        render_square_wave(audio, out, num_samples);
+}
@@ -0,0 +1,47 @@
+#ifndef CHIP8_AUDIO_H
+#define CHIP8_AUDIO_H
+
+#include "chip8_core.h"
+
+// Band-limited beeper synthesis shared by the SDL audio callback and the
+// headless WAV writer. The caller owns timing: it opens and closes the gate
+// on sound timer edges and hands over XO-CHIP pattern changes, then asks for
+// samples up to the next change.
+//
+// CHIP-8 and SUPER-CHIP play a polyBLEP square wave. XO-CHIP plays its 128
+// 1-bit samples at 4000*2^((pitch-64)/48) Hz, each bit edge a windowed sinc step.
+
+#define CHIP8_AUDIO_KERNEL_TAPS     16
+#define CHIP8_AUDIO_KERNEL_PHASES   64
+#define CHIP8_AUDIO_CHUNK           64  // Pattern samples integrated per pass
+
+typedef struct {
+    uint32_t    sample_rate;
+    uint32_t    square_wave_freq;
+    float       volume;
+    bool        xochip;         // Play the pattern instead of the square wave
+    bool        gate;           // Sound timer running, silence otherwise
+    uint8_t     pattern[16];
+    uint8_t     pitch;
+    float       delta_buf[CHIP8_AUDIO_CHUNK + CHIP8_AUDIO_KERNEL_TAPS];
+    float       level;          // Running sum of delta_buf, current output level
+    uint8_t     bit_index;      // Position in the 128 bit pattern
+    bool        bit;
+    double      bit_period;     // Output samples per pattern bit
+    double      next_edge;      // Output sample time of the next pattern bit
+    float       square_phase;   // Square wave oscillator phase in [0, 1)
+    // Band-limited impulse, one row per fractional sample offset.
+    // Each row sums to 1 so integrated steps land exactly on the new level.
+    float       kernel[CHIP8_AUDIO_KERNEL_PHASES][CHIP8_AUDIO_KERNEL_TAPS];
+} chip8_audio_t;
+
+void chip8_audio_init(chip8_audio_t *audio, const uint32_t sample_rate, const uint32_t square_wave_freq,
+                      const int16_t volume, const chip8_extension_t extension);
+void chip8_audio_set_pattern(chip8_audio_t *audio, const uint8_t pattern[16], const uint8_t pitch);
+void chip8_audio_render(chip8_audio_t *audio, int16_t *out, const uint32_t num_samples);
+
+// Emulated time in samples of instruction inst out of insts_per_frame in frame
+uint64_t chip8_audio_sample_time(const uint32_t sample_rate, const uint64_t frame,
+                                 const uint32_t inst, const uint32_t insts_per_frame);
+
+#endif
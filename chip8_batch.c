@@ -0,0 +1,486 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, sysconf, strdup
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chip8_core.h"
+
+// chip8-batch: run many ROMs headless across all cores and print one CSV row
+// per ROM. Every worker owns a contiguous range of jobs and takes from its
+// front; an idle worker steals the back half of the fullest other range.
+
+// Keypad change applied at the start of a frame, from the --input script
+typedef struct {
+    uint32_t    frame;
+    uint8_t     key;
+    bool        down;
+} input_event_t;
+
+typedef struct {
+    chip8_config_t  core;
+    uint32_t        insts_per_sec;
+    uint32_t        frames;
+    uint32_t        threads;
+    input_event_t   *events;
+    uint32_t        event_count;
+} batch_config_t;
+
+typedef struct {
+    const char  *rom_name;
+    bool        owned;      // rom_name was allocated here, argv paths are not
+    bool        ok;
+    uint32_t    frames;
+    uint64_t    cycles;
+    uint64_t    display_hash;
+    uint64_t    audio_hash;
+    double      wall_ms;
+} batch_job_t;
+
+// Remaining jobs [begin, end) packed as begin << 32 | end, so owner pops and
+// thief splits are each a single compare-and-swap
+typedef struct {
+    _Atomic uint64_t    range;
+    char                pad[64 - sizeof(uint64_t)];   // One queue per cache line
+} work_queue_t;
+
+typedef struct {
+    const batch_config_t    *config;
+    batch_job_t             *jobs;
+    work_queue_t            *queues;
+    uint32_t                worker_count;
+} batch_t;
+
+typedef struct {
+    batch_t     *batch;
+    uint32_t    id;
+    uint32_t    steals;
+#ifdef PROFILE
+    chip8_profile_t profile;    // The worker's thread-local counters, copied out on exit
+#endif
+} worker_t;
+
+#define RANGE(begin, end) ((uint64_t)(begin) << 32 | (uint32_t)(end))
+
+// Parse "<frame> <key hex> down|up" lines, # starts a comment
+bool load_input_script(batch_config_t *config, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Could not open input script %s\n", path);
+        return false;
+    }
+
+    uint32_t capacity = 0;
+    char line[256];
+    uint32_t line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+
+        unsigned frame, key;
+        char action[8];
+        const int fields = sscanf(line, "%u %x %7s", &frame, &key, action);
+        if (fields <= 0)
+            continue;
+        if (fields != 3 || key > 0xF || (strcmp(action, "down") != 0 && strcmp(action, "up") != 0)) {
+            fprintf(stderr, "%s:%u: expected <frame> <key 0-F> down|up\n", path, line_number);
+            fclose(file);
+            return false;
+        }
+        if (config->event_count > 0 && frame < config->events[config->event_count - 1].frame) {
+            fprintf(stderr, "%s:%u: frames must not decrease\n", path, line_number);
+            fclose(file);
+            return false;
+        }
+
+        if (config->event_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            input_event_t *events = realloc(config->events, capacity * sizeof(input_event_t));
+            if (!events) {
+                fclose(file);
+                return false;
+            }
+            config->events = events;
+        }
+        config->events[config->event_count++] = (input_event_t) {
+            .frame = frame,
+            .key = (uint8_t)key,
+            .down = strcmp(action, "down") == 0,
+        };
+    }
+
+    fclose(file);
+    return true;
+}
+
+// An owned rom_name belongs to the job list from here on, it is freed on failure too
+bool add_job(batch_job_t **jobs, uint32_t *count, uint32_t *capacity, const char *rom_name, const bool owned)
+{
+    if (!rom_name) {
+        fprintf(stderr, "Out of memory adding ROMs\n");
+        return false;
+    }
+    if (*count == *capacity) {
+        const uint32_t grown_capacity = *capacity ? *capacity * 2 : 256;
+        batch_job_t *grown = realloc(*jobs, grown_capacity * sizeof(batch_job_t));
+        if (!grown) {
+            fprintf(stderr, "Out of memory adding ROM %s\n", rom_name);
+            if (owned)
+                free((char *)rom_name);
+            return false;
+        }
+        *jobs = grown;
+        *capacity = grown_capacity;
+    }
+    (*jobs)[(*count)++] = (batch_job_t) {.rom_name = rom_name, .owned = owned};
+    return true;
+}
+
+void free_jobs(batch_job_t *jobs, const uint32_t count)
+{
+    uint32_t j;
+    for (j = 0; j < count; ++j)
+        if (jobs[j].owned)
+            free((char *)jobs[j].rom_name);
+    free(jobs);
+}
+
+int compare_jobs(const void *a, const void *b)
+{
+    return strcmp(((const batch_job_t *)a)->rom_name, ((const batch_job_t *)b)->rom_name);
+}
+
+// A directory adds every regular file in it, @file adds one path per line
+bool add_jobs(batch_job_t **jobs, uint32_t *count, uint32_t *capacity, const char *arg)
+{
+    if (arg[0] == '@') {
+        FILE *list = fopen(arg + 1, "r");
+        if (!list) {
+            fprintf(stderr, "Could not open ROM list %s\n", arg + 1);
+            return false;
+        }
+        char line[4096];
+        while (fgets(line, sizeof(line), list)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] && !add_job(jobs, count, capacity, strdup(line), true)) {
+                fclose(list);
+                return false;
+            }
+        }
+        fclose(list);
+        return true;
+    }
+
+    struct stat st;
+    if (stat(arg, &st) != 0) {
+        fprintf(stderr, "ROM %s does not exist\n", arg);
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return add_job(jobs, count, capacity, arg, false);
+
+    DIR *dir = opendir(arg);
+    if (!dir) {
+        fprintf(stderr, "Could not open ROM directory %s\n", arg);
+        return false;
+    }
+    const uint32_t first = *count;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        const size_t len = strlen(arg) + strlen(entry->d_name) + 2;
+        char *path = malloc(len);
+        if (!path) {
+            fprintf(stderr, "Out of memory reading ROM directory %s\n", arg);
+            closedir(dir);
+            return false;
+        }
+        snprintf(path, len, "%s/%s", arg, entry->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+        if (!add_job(jobs, count, capacity, path, true)) {
+            closedir(dir);
+            return false;
+        }
+    }
+    closedir(dir);
+
+    // readdir order is arbitrary, keep output stable between runs
+    qsort(*jobs + first, *count - first, sizeof(batch_job_t), compare_jobs);
+    return true;
+}
+
+bool set_config_from_args(batch_config_t *config, batch_job_t **jobs, uint32_t *job_count,
+                          const int argc, char **argv)
+{
+    *config = (batch_config_t) {
+        .core.current_extension = CHIP8_EXT_CHIP8,
+        .insts_per_sec          = 700,
+        .frames                 = 600,
+        .threads                = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN),
+    };
+
+    uint32_t capacity = 0;
+    int i;
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--frames", strlen("--frames")) == 0 && i + 1 < argc)
+            config->frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--insts-per-sec", strlen("--insts-per-sec")) == 0 && i + 1 < argc)
+            config->insts_per_sec = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--threads", strlen("--threads")) == 0 && i + 1 < argc)
+            config->threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--seed", strlen("--seed")) == 0 && i + 1 < argc)
+            config->core.seed = strtoull(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--input", strlen("--input")) == 0 && i + 1 < argc) {
+            if (!load_input_script(config, argv[++i]))
+                return false;
+        } else if (strncmp(argv[i], "--extension", strlen("--extension")) == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "chip8") == 0)
+                config->core.current_extension = CHIP8_EXT_CHIP8;
+            else if (strcmp(argv[i], "superchip") == 0)
+                config->core.current_extension = CHIP8_EXT_SUPERCHIP;
+            else if (strcmp(argv[i], "xochip") == 0)
+                config->core.current_extension = CHIP8_EXT_XOCHIP;
+            else {
+                fprintf(stderr, "Unknown extension %s\n", argv[i]);
+                return false;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        } else if (!add_jobs(jobs, job_count, &capacity, argv[i])) {
+            return false;
+        }
+    }
+
+    if (*job_count == 0) {
+        fprintf(stderr, "No ROMs given\n");
+        return false;
+    }
+    if (config->insts_per_sec < 60) {
+        fprintf(stderr, "--insts-per-sec must be at least 60\n");
+        return false;
+    }
+    if (config->threads == 0)
+        config->threads = 1;
+    if (config->threads > *job_count)
+        config->threads = *job_count;
+    return true;
+}
+
+double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// FNV-1a step over one value
+uint64_t hash_mix(uint64_t hash, const uint8_t *data, const size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+void run_job(const batch_config_t *config, chip8_t *chip8, batch_job_t *job)
+{
+    const double start = now_ms();
+    if (!chip8_init(chip8, config->core, job->rom_name)) {
+        job->wall_ms = now_ms() - start;
+        return;
+    }
+
+    // The audio hash covers what the frontend would play each frame: whether
+    // the buzzer is on and, for XO-CHIP, the pattern and pitch it plays
+    const uint32_t insts_per_frame = config->insts_per_sec / 60;
+    uint64_t audio_hash = 0xCBF29CE484222325ull;
+    uint32_t next_event = 0;
+    uint32_t frame, i;
+    for (frame = 0; frame < config->frames; ++frame) {
+        while (next_event < config->event_count && config->events[next_event].frame <= frame) {
+            chip8->keypad[config->events[next_event].key] = config->events[next_event].down;
+            next_event++;
+        }
+
+        for (i = 0; i < insts_per_frame; ++i)
+            chip8_emulate_instruction(chip8, config->core);
+
+        const uint8_t on = chip8->sound_timer > 0;
+        audio_hash = hash_mix(audio_hash, &on, 1);
+        if (on && config->core.current_extension == CHIP8_EXT_XOCHIP) {
+            audio_hash = hash_mix(audio_hash, chip8->audio_pattern, sizeof(chip8->audio_pattern));
+            audio_hash = hash_mix(audio_hash, &chip8->pitch, 1);
+        }
+        chip8_update_timers(chip8);
+    }
+
+    job->ok = true;
+    job->frames = config->frames;
+    job->cycles = (uint64_t)config->frames * insts_per_frame;
+    job->display_hash = chip8_display_hash(chip8);
+    job->audio_hash = audio_hash;
+    job->wall_ms = now_ms() - start;
+}
+
+// Pop the front job of our own range, -1 once it is empty
+int64_t take_job(work_queue_t *queue)
+{
+    uint64_t range = atomic_load(&queue->range);
+    for (;;) {
+        const uint32_t begin = range >> 32, end = (uint32_t)range;
+        if (begin >= end)
+            return -1;
+        if (atomic_compare_exchange_weak(&queue->range, &range, RANGE(begin + 1, end)))
+            return begin;
+    }
+}
+
+// Move the back half of the largest other range into ours and return its first
+// job, -1 once every range is empty
+int64_t steal_jobs(batch_t *batch, const uint32_t thief)
+{
+    for (;;) {
+        uint32_t victim = thief, most = 0, v;
+        for (v = 0; v < batch->worker_count; ++v) {
+            const uint64_t range = atomic_load(&batch->queues[v].range);
+            const uint32_t left = (uint32_t)range - (uint32_t)(range >> 32);
+            if (v != thief && (uint32_t)(range >> 32) < (uint32_t)range && left > most) {
+                most = left;
+                victim = v;
+            }
+        }
+        if (victim == thief)
+            return -1;
+
+        uint64_t range = atomic_load(&batch->queues[victim].range);
+        const uint32_t begin = range >> 32, end = (uint32_t)range;
+        if (begin >= end)
+            continue;
+        const uint32_t mid = begin + (end - begin) / 2;
+        if (atomic_compare_exchange_strong(&batch->queues[victim].range, &range, RANGE(begin, mid))) {
+            atomic_store(&batch->queues[thief].range, RANGE(mid + 1, end));
+            return mid;
+        }
+    }
+}
+
+void *batch_worker(void *data)
+{
+    worker_t *worker = data;
+    batch_t *batch = worker->batch;
+    work_queue_t *queue = &batch->queues[worker->id];
+
+    chip8_t *chip8 = chip8_alloc(1);
+    if (!chip8)
+        return NULL;
+
+    for (;;) {
+        int64_t job = take_job(queue);
+        if (job < 0) {
+            job = steal_jobs(batch, worker->id);
+            if (job < 0)
+                break;
+            worker->steals++;
+        }
+        run_job(batch->config, chip8, &batch->jobs[job]);
+    }
+
+    chip8_free(chip8);
+#ifdef PROFILE
+    worker->profile = *chip8_profile();
+#endif
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [--frames N] [--insts-per-sec N] [--threads N] [--seed N] "
+                        "[--extension chip8|superchip|xochip] [--input script] <rom|dir|@list>...\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    batch_config_t config;
+    batch_job_t *jobs = NULL;
+    uint32_t job_count = 0;
+    if (!set_config_from_args(&config, &jobs, &job_count, argc, argv))
+        exit(EXIT_FAILURE);
+
+    batch_t batch = {
+        .config = &config,
+        .jobs = jobs,
+        .queues = calloc(config.threads, sizeof(work_queue_t)),
+        .worker_count = config.threads,
+    };
+    pthread_t *threads = malloc(config.threads * sizeof(pthread_t));
+    worker_t *workers = calloc(config.threads, sizeof(worker_t));
+    if (!batch.queues || !threads || !workers) {
+        fprintf(stderr, "Could not allocate %u workers\n", config.threads);
+        exit(EXIT_FAILURE);
+    }
+
+    // Even initial split, stealing evens out ROMs that run faster or slower
+    uint32_t w;
+    for (w = 0; w < config.threads; ++w)
+        atomic_init(&batch.queues[w].range,
+                    RANGE((uint64_t)job_count * w / config.threads,
+                          (uint64_t)job_count * (w + 1) / config.threads));
+
+    const double start = now_ms();
+    for (w = 0; w < config.threads; ++w) {
+        workers[w] = (worker_t) {.batch = &batch, .id = w};
+        if (pthread_create(&threads[w], NULL, batch_worker, &workers[w]) != 0) {
+            fprintf(stderr, "Could not start worker thread %u\n", w);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint32_t steals = 0;
+    for (w = 0; w < config.threads; ++w) {
+        pthread_join(threads[w], NULL);
+        steals += workers[w].steals;
+    }
+    const double wall_ms = now_ms() - start;
+
+    printf("rom,ok,frames,cycles,display_hash,audio_hash,wall_ms\n");
+    uint64_t cycles = 0;
+    uint32_t failed = 0;
+    uint32_t j;
+    for (j = 0; j < job_count; ++j) {
+        const batch_job_t *job = &jobs[j];
+        printf("%s,%d,%u,%llu,%016llx,%016llx,%.3f\n", job->rom_name, job->ok, job->frames,
+               (long long unsigned)job->cycles, (long long unsigned)job->display_hash,
+               (long long unsigned)job->audio_hash, job->wall_ms);
+        cycles += job->cycles;
+        failed += !job->ok;
+    }
+    fprintf(stderr, "%u ROMs (%u failed) on %u threads in %.1f ms, %u steals, %.1f M instructions/s\n",
+            job_count, failed, config.threads, wall_ms, steals, cycles / wall_ms / 1e3);
+#ifdef PROFILE
+    chip8_profile_t profile = {0};
+    for (w = 0; w < config.threads; ++w)
+        chip8_profile_merge(&profile, &workers[w].profile);
+    chip8_profile_print(&profile, stderr);
+    chip8_profile_write_csv(&profile, "chip8_profile.csv");
+#endif
+
+    free(workers);
+    free(threads);
+    free(batch.queues);
+    free_jobs(jobs, job_count);
+    free(config.events);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1346 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#if defined(PROFILE) && defined(_WIN32)
+#include <windows.h>
+#elif defined(PROFILE)
+#include <time.h>
+#endif
+#include "chip8_internal.h"
+
+// Pointer for writing guest RAM, giving the machine its own copy of a shared page first
+uint8_t *chip8_ram_write(chip8_t *chip8, const uint16_t addr)
+{
+    const uint32_t page = GUEST_INDEX(addr >> 8, CHIP8_RAM_PAGES - 1);
+
+    if (!(chip8->ram_private_mask & (1 << page))) {
+        memcpy(chip8->ram_private[page], chip8->ram_page[page], CHIP8_RAM_PAGE_SIZE);
+        chip8->ram_page[page] = chip8->ram_private[page];
+        chip8->ram_private_mask |= 1 << page;
+    }
+    return &chip8->ram_page[page][addr & (CHIP8_RAM_PAGE_SIZE - 1)];
+}
+
+// Replace all of guest RAM, every page becomes private
+void chip8_load_ram(chip8_t *chip8, const uint8_t *src)
+{
+    uint32_t page;
+    for (page = 0; page < CHIP8_RAM_PAGES; ++page)
+        chip8->ram_page[page] = chip8->ram_private[page];
+    chip8->ram_private_mask = (1 << CHIP8_RAM_PAGES) - 1;
+    memcpy(chip8->ram_private, src, CHIP8_RAM_SIZE);
+}
+
+void chip8_store_ram(const chip8_t *chip8, uint8_t *dst)
+{
+    uint32_t page;
+    for (page = 0; page < CHIP8_RAM_PAGES; ++page)
+        memcpy(&dst[page * CHIP8_RAM_PAGE_SIZE], chip8->ram_page[page], CHIP8_RAM_PAGE_SIZE);
+}
+
+// PCG32 (XSH RR), a 64-bit LCG with a permuted 32-bit output
+static uint32_t chip8_random(chip8_t *chip8)
+{
+    const uint64_t old = chip8->rng_state;
+    chip8->rng_state = old * 6364136223846793005ull + 1442695040888963407ull;
+
+    const uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    const uint32_t rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// Reset the machine and load a ROM image already in memory. rom_name is only kept for reference.
+bool chip8_init_rom(chip8_t *chip8, const chip8_config_t config, const uint8_t *rom, const size_t rom_size,
+                    const char rom_name[])
+{
+    const uint8_t font[] = {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    };
+
+    // Initialize entire CHIP8 machine
+    memset(chip8, 0, sizeof(chip8_t));
+
+    uint32_t page;
+    for (page = 0; page < CHIP8_RAM_PAGES; ++page)
+        chip8->ram_page[page] = chip8->ram_private[page];
+    chip8->ram_private_mask = (1 << CHIP8_RAM_PAGES) - 1;
+
+    uint8_t *ram = &chip8->ram_private[0][0];
+    memcpy(ram, font, sizeof(font));
+
+    if (rom_size > CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT) {
+        fprintf(stderr, "ROM %s is too big. ROM size: %llu, max allowed size: %llu\n",
+                rom_name, (long long unsigned)rom_size, (long long unsigned)(CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT));
+        return false;
+    }
+    memcpy(&ram[CHIP8_ENTRY_POINT], rom, rom_size);
+
+    chip8->state = CHIP8_RUNNING;
+    chip8->PC = CHIP8_ENTRY_POINT;
+    chip8->rom_name = rom_name;
+    chip8->stack_ptr = 0;
+
+    // XO-CHIP default tone until a ROM loads its own pattern: 500 Hz square
+    memset(chip8->audio_pattern, 0xF0, sizeof(chip8->audio_pattern));
+    chip8->pitch = 64;
+    chip8->audio_changed = true;
+    chip8->fx0a_key = 0xFF;
+    chip8->ram_dirty = ~0ull;
+
+    // Same seed, same random stream, every reset of every instance
+    chip8->rng_state = 0;
+    chip8_random(chip8);
+    chip8->rng_state += config.seed;
+    chip8_random(chip8);
+    chip8->display_dirty = true;
+
+    return true;
+}
+
+bool chip8_init(chip8_t *chip8, const chip8_config_t config, const char rom_name[])
+{
+    uint8_t buf[CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT];
+
+    FILE *rom = fopen(rom_name, "rb");
+    if (!rom) {
+        fprintf(stderr, "ROM file %s is invalid or does not exist\n", rom_name);
+        return false;
+    }
+
+    fseek(rom, 0, SEEK_END);
+    const size_t rom_size = ftell(rom);
+    const size_t max_size = sizeof(buf);
+    rewind(rom);
+
+    if (rom_size > max_size) {
+        fprintf(stderr, "ROM file %s is too big. ROM size: %llu, max allowed size: %llu\n", 
+                rom_name, (long long unsigned)rom_size, (long long unsigned)max_size);
+        fclose(rom);
+        return false;
+    }
+    
+    // Counts bytes, not items, so an empty ROM reads fine
+    if (fread(buf, 1, rom_size, rom) != rom_size) {
+        fprintf(stderr, "Could not read ROM file %s into CHIP8 memory\n", rom_name);
+        fclose(rom);
+        return false;
+    }
+
+    fclose(rom);
+    return chip8_init_rom(chip8, config, buf, rom_size, rom_name);
+}
+
+// Adler-32 with the modulo deferred, valid for up to 5552 bytes
+static uint32_t state_checksum(const uint8_t *data, const size_t size)
+{
+    uint32_t a = 1, b = 0;
+    size_t i;
+    for (i = 0; i < size; ++i) {
+        a += data[i];
+        b += a;
+    }
+    return ((b % 65521) << 16) | (a % 65521);
+}
+
+// Pack the display 1 bit per pixel into out (64*32/8 bytes)
+static void pack_display(const chip8_t *chip8, uint8_t *out)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(chip8->display); i += 8, ++out)
+        *out = chip8->display[i + 0] << 7 | chip8->display[i + 1] << 6 |
+               chip8->display[i + 2] << 5 | chip8->display[i + 3] << 4 |
+               chip8->display[i + 4] << 3 | chip8->display[i + 5] << 2 |
+               chip8->display[i + 6] << 1 | chip8->display[i + 7] << 0;
+}
+
+static void unpack_display(chip8_t *chip8, const uint8_t *in)
+{
+    uint32_t i, j;
+    for (i = 0; i < sizeof(chip8->display) / 8; ++i)
+        for (j = 0; j < 8; ++j)
+            chip8->display[i * 8 + j] = (in[i] >> (7 - j)) & 1;
+}
+
+// Pack everything after the display, out has CHIP8_STATE_SIZE - CHIP8_STATE_REGS bytes
+static void pack_registers(const chip8_t *chip8, uint8_t *p)
+{
+    uint32_t i;
+    for (i = 0; i < CHIP8_STACK_SIZE; ++i) {
+        *p++ = chip8->stack[i] & 0xFF;
+        *p++ = chip8->stack[i] >> 8;
+    }
+    *p++ = chip8->stack_ptr;
+
+    memcpy(p, chip8->V, sizeof(chip8->V));
+    p += sizeof(chip8->V);
+    *p++ = chip8->I & 0xFF;
+    *p++ = chip8->I >> 8;
+    *p++ = chip8->PC & 0xFF;
+    *p++ = chip8->PC >> 8;
+    *p++ = chip8->delay_timer;
+    *p++ = chip8->sound_timer;
+    *p++ = chip8->fx0a_key;
+    *p++ = chip8->fx0a_key_pressed;
+    memcpy(p, chip8->audio_pattern, sizeof(chip8->audio_pattern));
+    p += sizeof(chip8->audio_pattern);
+    *p++ = chip8->pitch;
+
+    for (i = 0; i < 8; ++i)
+        *p++ = (chip8->rng_state >> (i * 8)) & 0xFF;
+}
+
+// Fields must already be validated, see chip8_load_state()
+static void unpack_registers(chip8_t *chip8, const uint8_t *p)
+{
+    uint32_t i;
+    for (i = 0; i < CHIP8_STACK_SIZE; ++i)
+        chip8->stack[i] = p[i * 2] | p[i * 2 + 1] << 8;
+    p += CHIP8_STACK_SIZE * 2;
+    chip8->stack_ptr = *p++;
+
+    memcpy(chip8->V, p, sizeof(chip8->V));
+    p += sizeof(chip8->V);
+    chip8->I = p[0] | p[1] << 8;
+    chip8->PC = p[2] | p[3] << 8;
+    p += 4;
+    chip8->delay_timer = *p++;
+    chip8->sound_timer = *p++;
+    chip8->fx0a_key = *p++;
+    chip8->fx0a_key_pressed = *p++;
+    memcpy(chip8->audio_pattern, p, sizeof(chip8->audio_pattern));
+    p += sizeof(chip8->audio_pattern);
+    chip8->pitch = *p++;
+
+    chip8->rng_state = 0;
+    for (i = 0; i < 8; ++i)
+        chip8->rng_state |= (uint64_t)p[i] << (i * 8);
+
+    chip8->draw = true;
+    chip8->audio_changed = true;
+}
+
+// Serialize the machine into buf (CHIP8_STATE_SIZE bytes), returns bytes written
+size_t chip8_save_state(const chip8_t *chip8, uint8_t *buf)
+{
+    chip8_store_ram(chip8, &buf[CHIP8_STATE_RAM]);
+    pack_display(chip8, &buf[CHIP8_STATE_DISPLAY]);
+    pack_registers(chip8, &buf[CHIP8_STATE_REGS]);
+
+    const uint32_t checksum = state_checksum(buf + CHIP8_STATE_HEADER, CHIP8_STATE_SIZE - CHIP8_STATE_HEADER);
+    memcpy(buf, CHIP8_STATE_MAGIC, 4);
+    buf[4] = CHIP8_STATE_VERSION & 0xFF;
+    buf[5] = CHIP8_STATE_VERSION >> 8;
+    buf[6] = CHIP8_STATE_SIZE & 0xFF;
+    buf[7] = CHIP8_STATE_SIZE >> 8;
+    buf[8] = checksum & 0xFF;
+    buf[9] = (checksum >> 8) & 0xFF;
+    buf[10] = (checksum >> 16) & 0xFF;
+    buf[11] = checksum >> 24;
+
+    return CHIP8_STATE_SIZE;
+}
+
+// Restore a blob written by chip8_save_state(). The machine is left untouched
+// unless the blob is intact and every field is in range.
+bool chip8_load_state(chip8_t *chip8, const uint8_t *buf, const size_t size)
+{
+    if (size != CHIP8_STATE_SIZE || memcmp(buf, CHIP8_STATE_MAGIC, 4) != 0)
+        return false;
+
+    const uint16_t version = buf[4] | buf[5] << 8;
+    const uint16_t state_size = buf[6] | buf[7] << 8;
+    const uint32_t checksum = (uint32_t)buf[8] | (uint32_t)buf[9] << 8 |
+                              (uint32_t)buf[10] << 16 | (uint32_t)buf[11] << 24;
+    if (version != CHIP8_STATE_VERSION || state_size != CHIP8_STATE_SIZE ||
+        checksum != state_checksum(buf + CHIP8_STATE_HEADER, CHIP8_STATE_SIZE - CHIP8_STATE_HEADER))
+        return false;
+
+    const uint8_t *regs = &buf[CHIP8_STATE_REGS];
+    const uint8_t stack_index = regs[CHIP8_STACK_SIZE * 2];
+    const uint16_t PC = regs[CHIP8_STACK_SIZE * 2 + 1 + 16 + 2] | regs[CHIP8_STACK_SIZE * 2 + 1 + 16 + 3] << 8;
+    const uint8_t fx0a_key = regs[CHIP8_STACK_SIZE * 2 + 1 + 16 + 6];
+    const uint8_t fx0a_key_pressed = regs[CHIP8_STACK_SIZE * 2 + 1 + 16 + 7];
+
+    if (stack_index >= CHIP8_STACK_SIZE || PC > CHIP8_ADDR_MASK)
+        return false;
+
+    // FX0A latches a key and sets pressed together and clears both together
+    if ((fx0a_key > 0xF && fx0a_key != 0xFF) || fx0a_key_pressed > 1 ||
+        fx0a_key_pressed != (fx0a_key != 0xFF))
+        return false;
+
+    chip8_load_ram(chip8, &buf[CHIP8_STATE_RAM]);
+    unpack_display(chip8, &buf[CHIP8_STATE_DISPLAY]);
+    unpack_registers(chip8, regs);
+
+    // Everything may differ from what the rewind buffer last captured
+    chip8->ram_dirty = ~0ull;
+    chip8->display_dirty = true;
+    return true;
+}
+
+// Zeroed, cache line aligned array of count machines, release with chip8_free()
+chip8_t *chip8_alloc(const size_t count)
+{
+    const size_t size = count * sizeof(chip8_t);
+#ifdef _WIN32
+    chip8_t *chip8 = _aligned_malloc(size, _Alignof(chip8_t));
+#else
+    chip8_t *chip8 = aligned_alloc(_Alignof(chip8_t), size);
+#endif
+    if (chip8)
+        memset(chip8, 0, size);
+    return chip8;
+}
+
+void chip8_free(chip8_t *chip8)
+{
+#ifdef _WIN32
+    _aligned_free(chip8);
+#else
+    free(chip8);
+#endif
+}
+
+// Set up a pool of forks of root. Root's current RAM becomes the pool's shared
+// pristine image, and root itself goes copy-on-write against it, so the pool
+// must outlive root.
+bool chip8_pool_init(chip8_pool_t *pool, chip8_t *root, const uint32_t capacity)
+{
+    pool->slots = chip8_alloc(capacity);
+    pool->free_slots = malloc(capacity * sizeof(uint32_t));
+    if (!pool->slots || !pool->free_slots) {
+        fprintf(stderr, "Could not allocate fork pool of %u machines\n", capacity);
+        // Leaves the pool empty, so a later chip8_pool_free() is harmless
+        chip8_pool_free(pool);
+        return false;
+    }
+
+    pool->capacity = capacity;
+    pool->free_count = capacity;
+    uint32_t i;
+    for (i = 0; i < capacity; ++i)
+        pool->free_slots[i] = capacity - 1 - i;
+
+    chip8_store_ram(root, &pool->pristine[0][0]);
+    for (i = 0; i < CHIP8_RAM_PAGES; ++i)
+        root->ram_page[i] = pool->pristine[i];
+    root->ram_private_mask = 0;
+    return true;
+}
+
+// Clone parent into a free pool slot. Only the pages parent has written since
+// the pool was set up are copied, the rest stay shared with the pristine image.
+// Returns NULL when the pool is full.
+chip8_t *chip8_fork(chip8_pool_t *pool, const chip8_t *parent)
+{
+    if (pool->free_count == 0)
+        return NULL;
+
+    chip8_t *child = &pool->slots[pool->free_slots[--pool->free_count]];
+    memcpy(child, parent, offsetof(chip8_t, ram_private));
+
+    uint16_t mask = parent->ram_private_mask;
+    while (mask) {
+        const int page = __builtin_ctz(mask);
+        memcpy(child->ram_private[page], parent->ram_private[page], CHIP8_RAM_PAGE_SIZE);
+        child->ram_page[page] = child->ram_private[page];
+        mask &= mask - 1;
+    }
+    return child;
+}
+
+void chip8_pool_release(chip8_pool_t *pool, chip8_t *child)
+{
+    pool->free_slots[pool->free_count++] = (uint32_t)(child - pool->slots);
+}
+
+void chip8_pool_free(chip8_pool_t *pool)
+{
+    chip8_free(pool->slots);
+    free(pool->free_slots);
+    pool->slots = NULL;
+    pool->free_slots = NULL;
+    pool->capacity = pool->free_count = 0;
+}
+
+// A zero budget leaves rewind disabled, NULL if out of memory
+chip8_rewind_t *chip8_rewind_create(const uint32_t budget_mb)
+{
+    chip8_rewind_t *rewind = calloc(1, sizeof(chip8_rewind_t));
+    if (!rewind) {
+        fprintf(stderr, "Could not allocate rewind state\n");
+        return NULL;
+    }
+    if (budget_mb == 0)
+        return rewind;
+
+    rewind->capacity = (size_t)budget_mb << 20;
+    rewind->buf = malloc(rewind->capacity);
+    if (!rewind->buf) {
+        fprintf(stderr, "Could not allocate %u MB rewind buffer\n", budget_mb);
+        free(rewind);
+        return NULL;
+    }
+    return rewind;
+}
+
+void chip8_rewind_free(chip8_rewind_t *rewind)
+{
+    if (!rewind)
+        return;
+    free(rewind->buf);
+    free(rewind);
+}
+
+// Append the XOR runs of new against shadow to out, updating shadow to new
+static uint8_t *encode_xor_runs(uint8_t *out, uint8_t *shadow, const uint8_t *new, const uint32_t offset, const uint32_t len)
+{
+    uint32_t i = 0;
+    while (i < len) {
+        if (shadow[i] == new[i]) {
+            ++i;
+            continue;
+        }
+
+        // Extend the run over short gaps, cheaper than another 3 byte header
+        uint32_t end = i + 1, gap = 0;
+        while (end < len && end - i < 255 && gap < 3) {
+            gap = (shadow[end] == new[end]) ? gap + 1 : 0;
+            ++end;
+        }
+        end -= gap;
+
+        const uint32_t pos = offset + i;
+        *out++ = pos & 0xFF;
+        *out++ = pos >> 8;
+        *out++ = end - i;
+        for (; i < end; ++i) {
+            *out++ = shadow[i] ^ new[i];
+            shadow[i] = new[i];
+        }
+    }
+    return out;
+}
+
+static void rewind_ring_copy(chip8_rewind_t *rewind, size_t pos, const uint8_t *src, uint8_t *dst, const size_t len)
+{
+    pos %= rewind->capacity;
+    const size_t first = (len < rewind->capacity - pos) ? len : rewind->capacity - pos;
+
+    if (src) {
+        memcpy(&rewind->buf[pos], src, first);
+        memcpy(rewind->buf, src + first, len - first);
+    } else {
+        memcpy(dst, &rewind->buf[pos], first);
+        memcpy(dst + first, rewind->buf, len - first);
+    }
+}
+
+// Called after every emulated frame. Only RAM pages and display marked dirty
+// since the last capture are compared, registers are always compared.
+void chip8_rewind_capture(chip8_rewind_t *rewind, chip8_t *chip8)
+{
+    if (!rewind->buf)
+        return;
+
+    if (!rewind->primed) {
+        chip8_save_state(chip8, rewind->shadow);
+        rewind->primed = true;
+        chip8->ram_dirty = 0;
+        chip8->display_dirty = false;
+        return;
+    }
+
+    uint8_t *out = rewind->scratch;
+    uint8_t packed[CHIP8_STATE_SIZE - CHIP8_STATE_DISPLAY];
+
+    uint64_t pages = chip8->ram_dirty;
+    while (pages) {
+        const uint32_t page = __builtin_ctzll(pages);
+        const uint32_t addr = page << DIRTY_PAGE_SHIFT;
+        out = encode_xor_runs(out, &rewind->shadow[CHIP8_STATE_RAM + addr],
+                              &chip8->ram_page[addr >> 8][addr & (CHIP8_RAM_PAGE_SIZE - 1)],
+                              CHIP8_STATE_RAM + addr, 1 << DIRTY_PAGE_SHIFT);
+        pages &= pages - 1;
+    }
+
+    if (chip8->display_dirty) {
+        pack_display(chip8, packed);
+        out = encode_xor_runs(out, &rewind->shadow[CHIP8_STATE_DISPLAY], packed,
+                              CHIP8_STATE_DISPLAY, CHIP8_STATE_REGS - CHIP8_STATE_DISPLAY);
+    }
+
+    pack_registers(chip8, packed);
+    out = encode_xor_runs(out, &rewind->shadow[CHIP8_STATE_REGS], packed,
+                          CHIP8_STATE_REGS, CHIP8_STATE_SIZE - CHIP8_STATE_REGS);
+
+    chip8->ram_dirty = 0;
+    chip8->display_dirty = false;
+
+    const uint32_t len = out - rewind->scratch;
+    const size_t needed = len + 2 * sizeof(uint32_t);
+    if (needed > rewind->capacity) {
+        rewind->used = rewind->frames = 0;
+        return;
+    }
+
+    // Evict the oldest frames until the new one fits the budget
+    while (rewind->capacity - rewind->used < needed) {
+        uint32_t old_len;
+        rewind_ring_copy(rewind, rewind->head + rewind->capacity - rewind->used, NULL,
+                         (uint8_t *)&old_len, sizeof(old_len));
+        rewind->used -= old_len + 2 * sizeof(uint32_t);
+        rewind->frames--;
+    }
+
+    rewind_ring_copy(rewind, rewind->head, (const uint8_t *)&len, NULL, sizeof(len));
+    rewind_ring_copy(rewind, rewind->head + sizeof(len), rewind->scratch, NULL, len);
+    rewind_ring_copy(rewind, rewind->head + sizeof(len) + len, (const uint8_t *)&len, NULL, sizeof(len));
+    rewind->head = (rewind->head + needed) % rewind->capacity;
+    rewind->used += needed;
+    rewind->frames++;
+}
+
+// Step the machine back one frame, returns false once history is exhausted
+bool chip8_rewind_step(chip8_rewind_t *rewind, chip8_t *chip8)
+{
+    if (!rewind->buf || rewind->frames == 0)
+        return false;
+
+    uint32_t len;
+    const size_t tail_pos = rewind->head + rewind->capacity - sizeof(len);
+    rewind_ring_copy(rewind, tail_pos, NULL, (uint8_t *)&len, sizeof(len));
+    rewind_ring_copy(rewind, tail_pos - len, NULL, rewind->scratch, len);
+
+    // XOR is its own inverse, applying the runs again gives the previous frame
+    const uint8_t *run = rewind->scratch;
+    while (run < rewind->scratch + len) {
+        const uint32_t pos = run[0] | run[1] << 8;
+        const uint32_t run_len = run[2];
+        uint32_t i;
+        for (i = 0; i < run_len; ++i)
+            rewind->shadow[pos + i] ^= run[3 + i];
+        run += 3 + run_len;
+    }
+
+    const size_t record = len + 2 * sizeof(uint32_t);
+    rewind->head = (rewind->head + rewind->capacity - record) % rewind->capacity;
+    rewind->used -= record;
+    rewind->frames--;
+
+    chip8_load_ram(chip8, &rewind->shadow[CHIP8_STATE_RAM]);
+    unpack_display(chip8, &rewind->shadow[CHIP8_STATE_DISPLAY]);
+    unpack_registers(chip8, &rewind->shadow[CHIP8_STATE_REGS]);
+    chip8->ram_dirty = 0;
+    chip8->display_dirty = false;
+    return true;
+}
+
+// Ring of the newest capacity records, rounded up to a power of two
+bool chip8_trace_init(chip8_trace_t *trace, const uint32_t capacity)
+{
+    uint32_t size = 1;
+    while (size < capacity && size < (1u << 31))
+        size <<= 1;
+
+    trace->records = calloc(size, sizeof(chip8_trace_record_t));
+    trace->capacity = size;
+    atomic_init(&trace->head, 0);
+    if (!trace->records) {
+        fprintf(stderr, "Could not allocate %u trace records\n", size);
+        return false;
+    }
+    return true;
+}
+
+// Dump the ring oldest first. The writer must be paused.
+bool chip8_trace_write(chip8_trace_t *trace, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open trace file %s\n", path);
+        return false;
+    }
+
+    const uint64_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    const uint64_t count = head < trace->capacity ? head : trace->capacity;
+    const uint64_t first = head - count;
+    chip8_trace_header_t header = {
+        .magic = CHIP8_TRACE_MAGIC,
+        .version = CHIP8_TRACE_VERSION,
+        .record_size = sizeof(chip8_trace_record_t),
+        .count = (uint32_t)count,
+        .first_cycle = first,
+    };
+
+    // Oldest records sit from the head slot to the end of the ring, then wrap
+    const uint64_t split = first & (trace->capacity - 1);
+    const uint64_t tail = count < trace->capacity - split ? count : trace->capacity - split;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(&trace->records[split], sizeof(chip8_trace_record_t), tail, file) == tail &&
+              fwrite(trace->records, sizeof(chip8_trace_record_t), count - tail, file) == count - tail;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        fprintf(stderr, "Could not write trace file %s\n", path);
+    return ok;
+}
+
+void chip8_trace_free(chip8_trace_t *trace)
+{
+    free(trace->records);
+    trace->records = NULL;
+}
+
+#ifdef DEBUG
+// Fill the next record with the state the instruction starts from
+static chip8_trace_record_t *trace_begin(chip8_t *chip8)
+{
+    chip8_trace_t *trace = chip8->trace;
+    const uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    chip8_trace_record_t *record = &trace->records[head & (trace->capacity - 1)];
+    const uint16_t opcode = chip8->inst.opcode;
+
+    uint16_t aux = 0;
+    if (opcode == 0x00EE)
+        aux = chip8->stack[(chip8->stack_ptr - 1) & (CHIP8_STACK_SIZE - 1)];
+    else if ((opcode >> 12) == 0xB)
+        aux = chip8->V[0];
+    else if ((opcode >> 12) == 0xE)
+        aux = chip8->keypad[chip8->V[chip8->inst.X] & 0xF];
+    else if ((opcode & 0xF0FF) == 0xF007)
+        aux = chip8->delay_timer;
+
+    record->cycle = (uint32_t)head;
+    record->PC = chip8->PC - 2;
+    record->opcode = opcode;
+    record->I = chip8->I;
+    record->aux = aux;
+    record->VX = chip8->V[chip8->inst.X];
+    record->VY = chip8->V[chip8->inst.Y];
+    return record;
+}
+
+// Complete the record and publish it to readers of the ring
+static void trace_end(chip8_t *chip8, chip8_trace_record_t *record)
+{
+    chip8_trace_t *trace = chip8->trace;
+    record->VX_after = chip8->V[chip8->inst.X];
+    record->VF_after = chip8->V[0xF];
+    atomic_store_explicit(&trace->head, atomic_load_explicit(&trace->head, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+#endif
+
+#ifdef PROFILE
+static const char *op_class_names[CHIP8_OP_CLASSES] = {
+    "00E0 CLS", "00EE RET", "0NNN SYS", "1NNN JP", "2NNN CALL", "3XNN/4XNN SKIP", "5XY0/9XY0 SKIP",
+    "6XNN LD", "7XNN ADD", "8XYN ALU", "ANNN LD I", "BNNN JP V0", "CXNN RND", "DXYN DRW",
+    "EX9E/EXA1 SKIP KEY", "FX0A WAIT KEY", "FX07/15/18 TIMER", "FX1E/29/33 I", "FX55/FX65 LOAD STORE",
+    "F002/FX3A AUDIO", "OTHER",
+};
+
+// One set of counters per thread, so batch workers never share cache lines
+static _Thread_local chip8_profile_t thread_profile;
+
+chip8_profile_t *chip8_profile(void)
+{
+    return &thread_profile;
+}
+
+static uint32_t op_class(const uint16_t opcode)
+{
+    const uint8_t NN = opcode & 0xFF;
+    switch (opcode >> 12) {
+    case 0x0: return opcode == 0x00E0 ? CHIP8_OP_CLS : opcode == 0x00EE ? CHIP8_OP_RET : CHIP8_OP_SYS;
+    case 0x1: return CHIP8_OP_JP;
+    case 0x2: return CHIP8_OP_CALL;
+    case 0x3: case 0x4: return CHIP8_OP_SKIP_IMM;
+    case 0x5: case 0x9: return CHIP8_OP_SKIP_REG;
+    case 0x6: return CHIP8_OP_LD_IMM;
+    case 0x7: return CHIP8_OP_ADD_IMM;
+    case 0x8: return CHIP8_OP_ALU;
+    case 0xA: return CHIP8_OP_LD_I;
+    case 0xB: return CHIP8_OP_JP_V0;
+    case 0xC: return CHIP8_OP_RND;
+    case 0xD: return CHIP8_OP_DRW;
+    case 0xE: return NN == 0x9E || NN == 0xA1 ? CHIP8_OP_SKIP_KEY : CHIP8_OP_OTHER;
+    default:
+        switch (NN) {
+        case 0x0A: return CHIP8_OP_WAIT_KEY;
+        case 0x07: case 0x15: case 0x18: return CHIP8_OP_TIMER;
+        case 0x1E: case 0x29: case 0x33: return CHIP8_OP_I_MATH;
+        case 0x55: case 0x65: return CHIP8_OP_LOAD_STORE;
+        case 0x02: case 0x3A: return CHIP8_OP_AUDIO;
+        default: return CHIP8_OP_OTHER;
+        }
+    }
+}
+
+// Monotonic, the wall clock can step under NTP in the middle of an instruction
+static uint64_t profile_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart * 1000000000ull +
+                      now.QuadPart % frequency.QuadPart * 1000000000ull / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static void profile_instruction(const uint16_t opcode, const uint64_t start_ns)
+{
+    const uint64_t ns = profile_ns() - start_ns;
+    const uint32_t c = op_class(opcode);
+    const uint32_t bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+
+    thread_profile.count[c]++;
+    thread_profile.ns[c] += ns;
+    thread_profile.histogram[c][bucket < CHIP8_PROFILE_BUCKETS ? bucket : CHIP8_PROFILE_BUCKETS - 1]++;
+}
+
+void chip8_profile_merge(chip8_profile_t *dst, const chip8_profile_t *src)
+{
+    uint32_t c, b;
+    for (c = 0; c < CHIP8_OP_CLASSES; ++c) {
+        dst->count[c] += src->count[c];
+        dst->ns[c] += src->ns[c];
+        for (b = 0; b < CHIP8_PROFILE_BUCKETS; ++b)
+            dst->histogram[c][b] += src->histogram[c][b];
+    }
+}
+
+// Upper bound in ns of the bucket holding the given fraction of a class
+static uint64_t profile_percentile(const chip8_profile_t *profile, const uint32_t c, const double fraction)
+{
+    uint64_t seen = 0;
+    uint32_t b;
+    for (b = 0; b < CHIP8_PROFILE_BUCKETS - 1; ++b) {
+        seen += profile->histogram[c][b];
+        if (seen >= fraction * profile->count[c])
+            break;
+    }
+    return 1ull << b;
+}
+
+// Table of the opcode classes by host time, most expensive first
+void chip8_profile_print(const chip8_profile_t *profile, FILE *out)
+{
+    uint32_t order[CHIP8_OP_CLASSES];
+    uint64_t total_count = 0, total_ns = 0;
+    uint32_t i, j;
+    for (i = 0; i < CHIP8_OP_CLASSES; ++i) {
+        order[i] = i;
+        total_count += profile->count[i];
+        total_ns += profile->ns[i];
+    }
+    for (i = 1; i < CHIP8_OP_CLASSES; ++i)
+        for (j = i; j > 0 && profile->ns[order[j]] > profile->ns[order[j - 1]]; --j) {
+            const uint32_t tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+
+    // Each sample includes one clock read
+    const uint64_t start = profile_ns();
+    for (i = 0; i < 1000; ++i)
+        profile_ns();
+    const double overhead_ns = (profile_ns() - start) / 1001.0;
+
+    fprintf(out, "%-22s %14s %7s %10s %7s %8s %8s %8s\n",
+            "opcode class", "count", "insts", "host ms", "time", "avg ns", "p50 <ns", "p99 <ns");
+    for (i = 0; i < CHIP8_OP_CLASSES; ++i) {
+        const uint32_t c = order[i];
+        if (profile->count[c] == 0)
+            continue;
+        fprintf(out, "%-22s %14llu %6.2f%% %10.3f %6.2f%% %8.1f %8llu %8llu\n",
+                op_class_names[c], (long long unsigned)profile->count[c],
+                profile->count[c] * 100.0 / total_count, profile->ns[c] / 1e6,
+                profile->ns[c] * 100.0 / total_ns, (double)profile->ns[c] / profile->count[c],
+                (long long unsigned)profile_percentile(profile, c, 0.5),
+                (long long unsigned)profile_percentile(profile, c, 0.99));
+    }
+    fprintf(out, "%llu instructions, %.3f host ms, clock read overhead ~%.1f ns per instruction\n",
+            (long long unsigned)total_count, total_ns / 1e6, overhead_ns);
+}
+
+void chip8_guest_profile_init(chip8_guest_profile_t *profile)
+{
+    memset(profile, 0, sizeof(chip8_guest_profile_t));
+    profile->nodes[0].entry = CHIP8_ENTRY_POINT;
+    profile->node_count = 1;
+}
+
+// Child of the current routine for a call to entry, created on first use
+static uint32_t guest_call_node(chip8_guest_profile_t *profile, const uint16_t entry)
+{
+    const uint16_t parent = profile->current;
+    const uint32_t mask = sizeof(profile->child_hash) / sizeof(profile->child_hash[0]) - 1;
+    uint32_t slot = ((parent * 0x9E3779B1u) ^ (entry * 0x85EBCA6Bu)) & mask;
+
+    for (;; slot = (slot + 1) & mask) {
+        const uint16_t node = profile->child_hash[slot];
+        if (node == 0)
+            break;
+        if (profile->nodes[node - 1].parent == parent && profile->nodes[node - 1].entry == entry)
+            return node - 1;
+    }
+
+    if (profile->node_count == CHIP8_CALL_NODES || profile->nodes[parent].depth + 1 >= CHIP8_STACK_SIZE)
+        return UINT32_MAX;
+    const uint32_t node = profile->node_count++;
+    profile->nodes[node] = (chip8_call_node_t){.parent = parent, .entry = entry,
+                                               .depth = profile->nodes[parent].depth + 1};
+    profile->child_hash[slot] = node + 1;
+    return node;
+}
+
+// Count the instruction at addr, then follow it into or out of a routine
+static void profile_guest(chip8_guest_profile_t *profile, const uint16_t addr, const uint16_t opcode)
+{
+    profile->pc_cycles[addr & CHIP8_ADDR_MASK]++;
+    profile->nodes[profile->current].cycles++;
+
+    if ((opcode & 0xF000) == 0x2000) {
+        const uint32_t node = profile->untracked_depth ? UINT32_MAX : guest_call_node(profile, opcode & 0x0FFF);
+        if (node == UINT32_MAX)
+            profile->untracked_depth++;
+        else
+            profile->current = node;
+    }
+    else if (opcode == 0x00EE) {
+        if (profile->untracked_depth)
+            profile->untracked_depth--;
+        else
+            profile->current = profile->nodes[profile->current].parent;
+    }
+}
+
+// The most executed addresses, with their share of all cycles
+void chip8_guest_profile_print(const chip8_guest_profile_t *profile, FILE *out, const uint32_t top)
+{
+    uint64_t total = 0;
+    uint32_t addr;
+    for (addr = 0; addr < CHIP8_RAM_SIZE; ++addr)
+        total += profile->pc_cycles[addr];
+    if (total == 0)
+        return;
+
+    // Repeated selection, top is small
+    bool shown[CHIP8_RAM_SIZE] = {0};
+    uint32_t i;
+    fprintf(out, "%-8s %14s %7s\n", "address", "cycles", "share");
+    for (i = 0; i < top; ++i) {
+        uint32_t best = CHIP8_RAM_SIZE;
+        for (addr = 0; addr < CHIP8_RAM_SIZE; ++addr)
+            if (!shown[addr] && profile->pc_cycles[addr] &&
+                (best == CHIP8_RAM_SIZE || profile->pc_cycles[addr] > profile->pc_cycles[best]))
+                best = addr;
+        if (best == CHIP8_RAM_SIZE)
+            break;
+        shown[best] = true;
+        fprintf(out, "0x%03X    %14llu %6.2f%%\n", best, (long long unsigned)profile->pc_cycles[best],
+                profile->pc_cycles[best] * 100.0 / total);
+    }
+    fprintf(out, "%u call paths, %llu cycles\n", profile->node_count, (long long unsigned)total);
+}
+
+// Collapsed stacks, one "rom;0x200;sub_0x2A0 cycles" line per call path, as
+// read by flamegraph.pl and speedscope
+bool chip8_guest_profile_write_folded(const chip8_guest_profile_t *profile, const char *rom_name,
+                                      const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Could not open guest profile %s\n", path);
+        return false;
+    }
+
+    // Frames are split on ';' and the count on the last space, keep the file name only
+    char name[64] = "rom";
+    const char *base = rom_name ? rom_name : name;
+    const char *p;
+    for (p = base; *p; ++p)
+        if (*p == '/' || *p == '\\')
+            base = p + 1;
+    uint32_t i;
+    for (i = 0; i < sizeof(name) - 1 && base[i]; ++i)
+        name[i] = base[i] == ';' || base[i] == ' ' ? '_' : base[i];
+    name[i] = '\0';
+
+    uint32_t n;
+    for (n = 0; n < profile->node_count; ++n) {
+        if (profile->nodes[n].cycles == 0)
+            continue;
+
+        uint16_t path_nodes[CHIP8_STACK_SIZE];
+        uint32_t depth = 0, node = n;
+        while (node != 0) {
+            path_nodes[depth++] = node;
+            node = profile->nodes[node].parent;
+        }
+
+        fprintf(file, "%s;0x%03X", name, CHIP8_ENTRY_POINT);
+        while (depth > 0)
+            fprintf(file, ";sub_0x%03X", profile->nodes[path_nodes[--depth]].entry);
+        fprintf(file, " %llu\n", (long long unsigned)profile->nodes[n].cycles);
+    }
+    return fclose(file) == 0;
+}
+
+bool chip8_profile_write_csv(const chip8_profile_t *profile, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Could not open profile CSV %s\n", path);
+        return false;
+    }
+
+    uint32_t c, b;
+    fprintf(file, "class,count,total_ns,avg_ns");
+    for (b = 0; b < CHIP8_PROFILE_BUCKETS - 1; ++b)
+        fprintf(file, ",lt_%lluns", 1ull << b);
+    fprintf(file, ",ge_%lluns\n", 1ull << (CHIP8_PROFILE_BUCKETS - 2));
+
+    for (c = 0; c < CHIP8_OP_CLASSES; ++c) {
+        fprintf(file, "%s,%llu,%llu,%.1f", op_class_names[c], (long long unsigned)profile->count[c],
+                (long long unsigned)profile->ns[c],
+                profile->count[c] ? (double)profile->ns[c] / profile->count[c] : 0.0);
+        for (b = 0; b < CHIP8_PROFILE_BUCKETS; ++b)
+            fprintf(file, ",%llu", (long long unsigned)profile->histogram[c][b]);
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
+#endif
+
+void chip8_emulate_instruction(chip8_t *chip8, const chip8_config_t config)
+{
+#ifdef PROFILE
+    const uint64_t profile_start = profile_ns();
+#endif
+    bool carry;
+    chip8->inst.opcode = (chip8_ram_read(chip8, chip8->PC) << 8 | chip8_ram_read(chip8, chip8->PC + 1));
+    chip8->PC += 2;
+
+    chip8->inst.NNN = chip8->inst.opcode & 0x0FFF;
+    chip8->inst.NN  = chip8->inst.opcode & 0x0FF;
+    chip8->inst.N   = chip8->inst.opcode & 0x0F;
+    chip8->inst.X   = (chip8->inst.opcode >> 8) & 0x0F;
+    chip8->inst.Y   = (chip8->inst.opcode >> 4) & 0x0F;
+
+#ifdef DEBUG
+    chip8_trace_record_t *trace_record = chip8->trace ? trace_begin(chip8) : NULL;
+#endif
+#ifdef PROFILE
+    if (chip8->guest_profile)
+        profile_guest(chip8->guest_profile, chip8->PC - 2, chip8->inst.opcode);
+#endif
+
+    switch ((chip8->inst.opcode >> 12) & 0x0F) {
+    case 0x00:
+        if (chip8->inst.NN == 0xE0) {
+            // 0x00E0: Clears the screen
+            memset(chip8->display, 0, sizeof(chip8->display));
+            chip8->draw = true;
+            chip8->display_dirty = true;
+        }
+        else if (chip8->inst.NN == 0xEE) {
+            // 0x00EE: Returns from subrutine
+            chip8->stack_ptr = GUEST_INDEX(chip8->stack_ptr - 1, CHIP8_STACK_SIZE - 1);
+            chip8->PC = chip8->stack[chip8->stack_ptr];
+        }
+        else {
+            // Unimplemented/invalid opcode, 0xNNN?
+        }            
+        break;
+    
+    case 0x01:
+        // 1NNN: Jumps to address NNN
+        chip8->PC = chip8->inst.NNN;
+        break;
+
+    case 0x02:
+        // 0x2NNN: Calls subrutine at NNN
+        chip8->stack[chip8->stack_ptr] = chip8->PC;
+        chip8->stack_ptr = GUEST_INDEX(chip8->stack_ptr + 1, CHIP8_STACK_SIZE - 1);
+        chip8->PC = chip8->inst.NNN;
+        break;
+    
+    case 0x03:
+        // 3XNN: Skips the next instruction if VX == NN
+        if (chip8->V[chip8->inst.X] == chip8->inst.NN)
+            chip8->PC += 2;
+        break;
+
+    case 0x04:
+        // 4XNN: Skips the next instruction if VX != NN
+        if (chip8->V[chip8->inst.X] != chip8->inst.NN)
+            chip8->PC += 2;
+        break;
+
+    case 0x05:
+        // 5XY0: Skips the next instruction if VX == VY
+        if (chip8->inst.N != 0)
+            break;
+        if (chip8->V[chip8->inst.X] == chip8->V[chip8->inst.Y])
+            chip8->PC += 2;
+        break;
+
+    case 0x06:
+        // 6XNN: Sets VX to NN
+        chip8->V[chip8->inst.X] = chip8->inst.NN;
+        break;
+
+    case 0x07:
+        // 7XNN: Adds NN to VX (carry flag is not changed)
+        chip8->V[chip8->inst.X] += chip8->inst.NN;
+        break;
+
+    case 0x08:
+        switch (chip8->inst.N) {
+        case 0x0:
+            // 8XY0: Sets VX to the value of VY
+            chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y];
+            break;
+        
+        case 0x1:
+            // 8XY1: Sets VX to VX or VY
+            chip8->V[chip8->inst.X] |= chip8->V[chip8->inst.Y];
+            if (config.current_extension == CHIP8_EXT_CHIP8)
+                chip8->V[0xF] = 0;
+            break;
+        
+        case 0x2:
+            // 8XY2: Sets VX to VX and VY
+            chip8->V[chip8->inst.X] &= chip8->V[chip8->inst.Y];
+            if (config.current_extension == CHIP8_EXT_CHIP8)
+                chip8->V[0xF] = 0;
+            break;
+        
+        case 0x3:
+            // 8XY3: Sets VX to VX xor VY
+            chip8->V[chip8->inst.X] ^= chip8->V[chip8->inst.Y];
+            if (config.current_extension == CHIP8_EXT_CHIP8)
+                chip8->V[0xF] = 0;
+            break;
+        
+        case 0x4:
+            // 8XY4: Adds VY to VX
+            // VF is set to 1 when there's a carry, and to 0 when there is not 
+            carry = ((uint16_t)(chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255);
+
+            chip8->V[chip8->inst.X] += chip8->V[chip8->inst.Y];
+            chip8->V[0xF] = carry;
+            break;
+        
+        case 0x5:
+            // 8XY5: VY is subtracted from VX
+            // VF is set to 0 when there's a borrow, and 1 when there is not
+            carry = (chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]);
+
+            chip8->V[chip8->inst.X] -= chip8->V[chip8->inst.Y];
+            chip8->V[0xF] = carry;
+            break;
+        
+        case 0x6:
+            // 8XY6: Stores the most significant bit of VX in VF
+            // and then shifts VX to the left by 1
+            if (config.current_extension == CHIP8_EXT_CHIP8) {
+                carry = (chip8->V[chip8->inst.Y] & 1);
+                chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] >> 1;
+            } else {
+                carry = (chip8->V[chip8->inst.X] & 1);
+                chip8->V[chip8->inst.X] >>= 1;
+            }
+            chip8->V[0xF] = carry;
+            break;
+        
+        case 0x7:
+            // 8XY7: Sets VX to VY minus VX. VF is set to 0 
+            // when there's a borrow, and 1 when there is not.
+            carry = (chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]);
+            
+            chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X];
+            chip8->V[0xF] = carry;
+            break;
+        
+        case 0xE:
+            // 8XYE: Stores the most significant bit of VX in VF 
+            // and then shifts VX to the left by 1.
+            if (config.current_extension == CHIP8_EXT_CHIP8) {
+                carry = (chip8->V[chip8->inst.Y] & 0x80) >> 7;
+                chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] << 1;
+            } else {
+                carry = (chip8->V[chip8->inst.X] & 0x80) >> 7;
+                chip8->V[chip8->inst.X] <<= 1;
+            }
+            chip8->V[0xF] = carry;
+            break;
+
+        default:
+            // Wrong or unimplemented opcode
+            break;
+        }
+        break;
+
+    case 0x09:
+        // 9XY0: Skips the next instruction if VX does not equal VY
+        if (chip8->V[chip8->inst.X] != chip8->V[chip8->inst.Y])
+            chip8->PC += 2;
+        break;
+
+    case 0x0A:
+        // ANNN: Sets I to the address NNN
+        chip8->I = chip8->inst.NNN;
+        break;
+
+    case 0x0B:
+        // BNNN: Jumps to the address NNN plus V0
+        chip8->PC = chip8->V[0] + chip8->inst.NNN;
+        break;
+
+    case 0x0C:
+        // CNNN: Sets VX to the result of a bitwise and 
+        // operation on a random number (Typically: 0 to 255) and NN. 
+        chip8->V[chip8->inst.X] = chip8_random(chip8) & chip8->inst.NN;
+        break;   
+    
+    case 0x0D:
+        // DXYN: Draws a sprite at coordinate (VX, VY) that. 
+        // Read from location I.
+        // Screen pixels are XOR'd with sprite bits,
+        // VF (Carry Flag) is set if any screen pixels are set off.
+        uint8_t x_coord = chip8->V[chip8->inst.X] % CHIP8_DISPLAY_WIDTH;
+        uint8_t y_coord = chip8->V[chip8->inst.Y] % CHIP8_DISPLAY_HEIGHT;
+        const uint8_t orig_x = x_coord;
+        
+        chip8->V[0xF] = 0;
+
+        // Loop over all N rows of the sprite
+        uint8_t i;
+        int8_t j;
+        for (i = 0; i < chip8->inst.N; ++i) {
+            // Get index row/byte of sprite data
+            const uint8_t sprite_data = chip8_ram_read(chip8, chip8->I + i);
+            x_coord = orig_x; // Reset X for next row to draw
+
+            for (j = 7; j >= 0; --j) {
+                // If sprite pixel/bit is on and display pixel is on, set carry flag
+                bool *pixel = &chip8->display[y_coord * CHIP8_DISPLAY_WIDTH + x_coord];
+                const bool sprite_bit = (sprite_data & (1 << j));
+                
+                if (sprite_bit && *pixel) {
+                    chip8->V[0xF] = 1;
+                }
+
+                // XOR display pixel with sprite pixel/bit
+                *pixel ^= sprite_bit;
+
+                // Stop drawing if hit right edge of screen
+                if (++x_coord >= CHIP8_DISPLAY_WIDTH)
+                    break;
+            }
+            // Stop drawing entire sprite if hit bottom page of screen
+            if (++y_coord >= CHIP8_DISPLAY_HEIGHT)
+                break;
+        }
+        chip8->draw = true;
+        chip8->display_dirty = true;
+        break;
+
+    case 0x0E:
+        switch (chip8->inst.NN) {
+        case 0x9E:
+            // EX9E: Skips the next instruction if the key stored in VX is pressed
+            if (chip8->keypad[GUEST_INDEX(chip8->V[chip8->inst.X], 0xF)])
+                chip8->PC += 2;
+            break;
+        case 0xA1:
+            // EXA1: Skips the next instruction if the key stored in VX is not pressed
+            if (!chip8->keypad[GUEST_INDEX(chip8->V[chip8->inst.X], 0xF)])
+                chip8->PC += 2;
+            break;
+        
+        default:
+            // No opcode
+            break;
+        }
+        break;
+
+    case 0x0F:
+        switch (chip8->inst.NN) {
+        case 0x02:
+            // F002: Loads the 16 byte audio pattern buffer from memory at I (XO-CHIP)
+            if (config.current_extension != CHIP8_EXT_XOCHIP || chip8->inst.X != 0)
+                break;
+            for (i = 0; i < sizeof(chip8->audio_pattern); ++i)
+                chip8->audio_pattern[i] = chip8_ram_read(chip8, chip8->I + i);
+            chip8->audio_changed = true;
+            break;
+
+        case 0x07:
+            // FX07: Sets VX to the value of the delay timer
+            chip8->V[chip8->inst.X] = chip8->delay_timer;
+            break;
+
+        case 0x0A:
+            // FX0A: A key press is awaited, and then stored in VX
+            uint8_t i;
+            for (i = 0; (chip8->fx0a_key == 0xFF) && (i < sizeof(chip8->keypad)); ++i) 
+                if (chip8->keypad[i]) {
+                    chip8->fx0a_key = i;
+                    chip8->fx0a_key_pressed = true;
+                    break;
+                }
+
+            // Run the same opcode if no key has been pressed yet
+            if (!chip8->fx0a_key_pressed) {
+                chip8->PC -= 2;
+            } else {
+                if (chip8->keypad[GUEST_INDEX(chip8->fx0a_key, 0xF)]) {
+                    chip8->PC -= 2;
+                }
+                else {
+                    chip8->V[chip8->inst.X] = chip8->fx0a_key;
+                    chip8->fx0a_key = 0xFF;
+                    chip8->fx0a_key_pressed = false;
+                }
+            } 
+            break;
+
+        case 0x15:
+            // FX15: Sets the delay timer to VX
+            chip8->delay_timer = chip8->V[chip8->inst.X];
+            break;
+
+        case 0x18:
+            // FX18: Sets the sound timer to VX
+            chip8->sound_timer = chip8->V[chip8->inst.X];
+            break;
+
+        case 0x1E:
+            // FX1E: Adds VX to I. VF is not affected.
+            chip8->I += chip8->V[chip8->inst.X];
+            break;
+
+        case 0x3A:
+            // FX3A: Sets the audio pattern playback pitch to VX (XO-CHIP)
+            if (config.current_extension != CHIP8_EXT_XOCHIP)
+                break;
+            chip8->pitch = chip8->V[chip8->inst.X];
+            chip8->audio_changed = true;
+            break;
+
+        case 0x29:
+            // FX29: Sets I to the location of the sprite for the character in VX.
+            // Characters 0-F (in hexadecimal) are represented by a 4x5 font. 
+            chip8->I = chip8->V[chip8->inst.X] * 5;
+            break;
+
+        case 0x33:
+            // FX33: Stores the binary-coded decimal representation of VX,
+            // with the hundreds digit in memory at location in I,
+            // the tens digit at location I+1, and the ones digit at location I+2. 
+            uint8_t bcd = chip8->V[chip8->inst.X];
+            MARK_RAM_DIRTY(chip8, chip8->I, 3);
+            *chip8_ram_write(chip8, chip8->I + 2) = bcd % 10;
+            bcd /= 10;
+            *chip8_ram_write(chip8, chip8->I + 1) = bcd % 10;
+            bcd /= 10;
+            *chip8_ram_write(chip8, chip8->I + 0) = bcd;
+            break;
+
+        case 0x55:
+            // FX55: Stores from V0 to VX (including VX) in memory, starting at address I.
+            // The offset from I is increased by 1 for each value written, but I itself is left unmodified.
+            // CHIP8 does increment I, SCHIP does not increment I.
+            MARK_RAM_DIRTY(chip8, chip8->I, chip8->inst.X + 1);
+            for (i = 0; i <= chip8->inst.X; ++i)                
+                if (config.current_extension == CHIP8_EXT_CHIP8)
+                    *chip8_ram_write(chip8, chip8->I++) = chip8->V[i];
+                else 
+                    *chip8_ram_write(chip8, chip8->I + i) = chip8->V[i];
+                
+            break;
+
+        case 0x65:
+            // FX65: Fills from V0 to VX (including VX) with values from memory, starting at address I.
+            // The offset from I is increased by 1 for each value read, but I itself is left unmodified.
+            // CHIP8 does increment I, SCHIP does not increment I.
+            for (i = 0; i <= chip8->inst.X; ++i)
+                if (config.current_extension == CHIP8_EXT_CHIP8)
+                    chip8->V[i] = chip8_ram_read(chip8, chip8->I++);
+                else
+                    chip8->V[i] = chip8_ram_read(chip8, chip8->I + i);
+                
+            break;
+        
+        default:
+            break;
+        }
+        break;
+
+    default:
+        break; // Unimplemented instuction
+    }
+
+    // Skips at 0xFFE, BNNN and FX0A wrap around the address space like the hardware
+    chip8->PC = GUEST_INDEX(chip8->PC, CHIP8_ADDR_MASK);
+
+#ifdef DEBUG
+    if (trace_record)
+        trace_end(chip8, trace_record);
+#endif
+#ifdef PROFILE
+    profile_instruction(chip8->inst.opcode, profile_start);
+#endif
+}
+
+void chip8_update_timers(chip8_t *chip8)
+{
+    if (chip8->delay_timer > 0)
+        chip8->delay_timer--;
+    if (chip8->sound_timer > 0)
+        chip8->sound_timer--;
+}
+
+// FNV-1a over the display, one byte per pixel
+uint64_t chip8_display_hash(const chip8_t *chip8)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    uint32_t i;
+    for (i = 0; i < sizeof(chip8->display); ++i) {
+        hash ^= chip8->display[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
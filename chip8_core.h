@@ -0,0 +1,269 @@
+#ifndef CHIP8_CORE_H
+#define CHIP8_CORE_H
+
+// libchip8: the CHIP-8 machine without any video, audio or input backend.
+// Frontends feed chip8_t.keypad, run chip8_emulate_instruction() insts_per_sec / 60
+// times and chip8_update_timers() once per 60 Hz frame, and read back display,
+// sound_timer and the XO-CHIP audio pattern.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#ifdef PROFILE
+#include <stdio.h>
+#endif
+
+typedef enum {
+    CHIP8_QUIT = 0,
+    CHIP8_RUNNING,
+    CHIP8_PAUSED,
+} chip8_run_state_t;
+
+typedef enum {
+    CHIP8_EXT_CHIP8,
+    CHIP8_EXT_SUPERCHIP,
+    CHIP8_EXT_XOCHIP,
+} chip8_extension_t;
+
+// Machine settings the core needs, the frontend keeps everything else
+typedef struct {
+    chip8_extension_t current_extension;
+    uint64_t    seed;           // CXNN random seed
+} chip8_config_t;
+
+#define CHIP8_DISPLAY_WIDTH     64
+#define CHIP8_DISPLAY_HEIGHT    32
+
+typedef struct {
+    uint16_t    opcode;
+    uint16_t    NNN;
+    uint8_t     NN;
+    uint8_t     N;
+    uint8_t     X;
+    uint8_t     Y;
+} chip8_instruction_t;
+
+// Guest RAM is 16 pages of 256 bytes. A page is either private to the machine
+// or points at a read-only pristine image shared by every fork of the same ROM,
+// and is copied into ram_private on its first write.
+#define CHIP8_RAM_SIZE        4096
+#define CHIP8_RAM_PAGE_SIZE   256
+#define CHIP8_RAM_PAGES       (CHIP8_RAM_SIZE / CHIP8_RAM_PAGE_SIZE)
+#define CHIP8_ADDR_MASK (CHIP8_RAM_SIZE - 1)
+
+// Return addresses, the index wraps so 2NNN/00EE never leave the array
+#define CHIP8_STACK_SIZE 16
+
+#define CHIP8_CACHE_LINE 64
+
+// Instruction trace: the DEBUG build appends one fixed-size record per
+// instruction to a ring, chip8-trace decodes a dump of it offline.
+typedef struct {
+    uint32_t    cycle;      // Instructions traced before this one, low 32 bits
+    uint16_t    PC;
+    uint16_t    opcode;
+    uint16_t    I;          // Before the instruction
+    uint16_t    aux;        // Before: 00EE return address, BNNN V0, EX9E/EXA1 key state, FX07 delay timer
+    uint8_t     VX;         // Before
+    uint8_t     VY;         // Before
+    uint8_t     VX_after;   // The register most instructions change, and the flag
+    uint8_t     VF_after;
+} chip8_trace_record_t;
+
+typedef struct {
+    chip8_trace_record_t    *records;
+    uint32_t                capacity;   // Power of two
+    _Atomic uint64_t        head;       // Records written, the ring holds the newest capacity
+} chip8_trace_t;
+
+// Trace file: header, then count records oldest first
+#define CHIP8_TRACE_MAGIC   "C8TR"
+#define CHIP8_TRACE_VERSION 1
+
+typedef struct {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    record_size;
+    uint32_t    count;
+    uint64_t    first_cycle;    // Full cycle of the first record, later ones unwrap from it
+} chip8_trace_header_t;
+
+// Guest hotspots: cycles per address and per call path. Paths are a tree of
+// routines keyed by their 2NNN entry address, followed by 00EE back up.
+#define CHIP8_CALL_NODES 4096
+
+typedef struct {
+    uint16_t    parent;
+    uint16_t    entry;              // 2NNN target, CHIP8_ENTRY_POINT for the root
+    uint8_t     depth;
+    uint64_t    cycles;             // Instructions executed in this routine itself
+} chip8_call_node_t;
+
+typedef struct {
+    uint64_t            pc_cycles[CHIP8_RAM_SIZE];
+    chip8_call_node_t   nodes[CHIP8_CALL_NODES];
+    uint16_t            child_hash[CHIP8_CALL_NODES * 2];   // Node index + 1, 0 for empty
+    uint32_t            node_count;
+    uint16_t            current;
+    uint32_t            untracked_depth;    // Calls past a full tree or CHIP8_STACK_SIZE deep
+} chip8_guest_profile_t;
+
+// Laid out by access frequency. Machines are cache line aligned, so heap
+// copies must come from chip8_alloc() or a pool.
+typedef struct {
+    // Hot: registers in the first line, stack and keypad in the second
+    _Alignas(CHIP8_CACHE_LINE)
+    uint16_t            PC;
+    uint16_t            I;
+    uint8_t             V[16];
+    uint8_t             delay_timer;
+    uint8_t             sound_timer;
+    uint8_t             stack_ptr;          // Next free entry, always < CHIP8_STACK_SIZE
+    uint8_t             fx0a_key;           // Key latched by FX0A, 0xFF if none yet
+    bool                fx0a_key_pressed;   // FX0A waits for the latched key to be released
+    bool                draw;
+    bool                display_dirty;      // Display changed since the last rewind capture
+    uint16_t            ram_private_mask;   // Pages backed by ram_private
+    chip8_instruction_t       inst;
+    uint64_t            ram_dirty;          // 64 byte RAM pages written since the last rewind capture
+    uint64_t            rng_state;          // PCG32 state for CXNN, seeded from config.seed
+    uint16_t            stack[CHIP8_STACK_SIZE];
+    bool                keypad[16];
+
+    // Read on every fetch, two lines of their own
+    _Alignas(CHIP8_CACHE_LINE)
+    uint8_t             *ram_page[CHIP8_RAM_PAGES];
+
+    // Warm: XO-CHIP audio, then host bookkeeping the core rarely touches
+    uint8_t             audio_pattern[16];  // XO-CHIP 1-bit sample pattern (F002)
+    uint8_t             pitch;              // XO-CHIP playback pitch (FX3A)
+    bool                audio_changed;      // Pattern or pitch needs publishing to audio
+    chip8_run_state_t    state;
+    const char          *rom_name;
+    // Present in every build so the layout never changes, only the PROFILE
+    // and DEBUG builds of chip8_emulate_instruction() feed them
+    chip8_guest_profile_t *guest_profile;   // Attached by the frontend, NULL for none
+    chip8_trace_t       *trace;             // Attached by the frontend, NULL for none
+
+    // Only DXYN and 00E0 write the display
+    _Alignas(CHIP8_CACHE_LINE)
+    bool                display[64*32];
+
+    // Not copied by chip8_fork(), keep last
+    uint8_t             ram_private[CHIP8_RAM_PAGES][CHIP8_RAM_PAGE_SIZE];
+} chip8_t;
+
+// Forks of one root machine, sharing its RAM image as loaded
+typedef struct {
+    uint8_t     pristine[CHIP8_RAM_PAGES][CHIP8_RAM_PAGE_SIZE];
+    chip8_t     *slots;
+    uint32_t    *free_slots;
+    uint32_t    capacity;
+    uint32_t    free_count;
+} chip8_pool_t;
+
+// Savestate blob: 12 byte header (magic, version, size, Adler-32 of the payload)
+// followed by a fixed layout payload. Multi-byte fields are little-endian.
+// Excludes rom_name and host keypad input.
+#define CHIP8_STATE_MAGIC   "C8SS"
+#define CHIP8_STATE_VERSION 3
+#define CHIP8_STATE_HEADER  12
+#define CHIP8_STATE_RAM     CHIP8_STATE_HEADER
+#define CHIP8_STATE_DISPLAY (CHIP8_STATE_RAM + 4096)
+#define CHIP8_STATE_REGS    (CHIP8_STATE_DISPLAY + 64 * 32 / 8) /* 1 bit per pixel */
+#define CHIP8_STATE_SIZE    (CHIP8_STATE_REGS + \
+                             16 * 2 + 1 +   /* stack, stack index */ \
+                             16 + 2 + 2 +   /* V, I, PC */ \
+                             1 + 1 +        /* delay and sound timers */ \
+                             1 + 1 +        /* FX0A latch */ \
+                             16 + 1 +       /* XO-CHIP audio pattern, pitch */ \
+                             8)             /* CXNN random generator state */
+
+// Rewind history of per-frame state deltas, see chip8_internal.h
+typedef struct chip8_rewind chip8_rewind_t;
+
+#ifdef PROFILE
+// Instrumentation build: executions and host time per opcode class, counted
+// per thread by chip8_emulate_instruction()
+enum {
+    CHIP8_OP_CLS,           // 00E0
+    CHIP8_OP_RET,           // 00EE
+    CHIP8_OP_SYS,           // Other 0NNN
+    CHIP8_OP_JP,            // 1NNN
+    CHIP8_OP_CALL,          // 2NNN
+    CHIP8_OP_SKIP_IMM,      // 3XNN, 4XNN
+    CHIP8_OP_SKIP_REG,      // 5XY0, 9XY0
+    CHIP8_OP_LD_IMM,        // 6XNN
+    CHIP8_OP_ADD_IMM,       // 7XNN
+    CHIP8_OP_ALU,           // 8XYN
+    CHIP8_OP_LD_I,          // ANNN
+    CHIP8_OP_JP_V0,         // BNNN
+    CHIP8_OP_RND,           // CXNN
+    CHIP8_OP_DRW,           // DXYN
+    CHIP8_OP_SKIP_KEY,      // EX9E, EXA1
+    CHIP8_OP_WAIT_KEY,      // FX0A
+    CHIP8_OP_TIMER,         // FX07, FX15, FX18
+    CHIP8_OP_I_MATH,        // FX1E, FX29, FX33
+    CHIP8_OP_LOAD_STORE,    // FX55, FX65
+    CHIP8_OP_AUDIO,         // F002, FX3A
+    CHIP8_OP_OTHER,
+    CHIP8_OP_CLASSES
+};
+
+// Bucket b counts instructions that took under 2^b ns, the last one the rest
+#define CHIP8_PROFILE_BUCKETS 16
+
+typedef struct {
+    uint64_t    count[CHIP8_OP_CLASSES];
+    uint64_t    ns[CHIP8_OP_CLASSES];
+    uint64_t    histogram[CHIP8_OP_CLASSES][CHIP8_PROFILE_BUCKETS];
+} chip8_profile_t;
+#endif
+
+#define CHIP8_ENTRY_POINT   0x200   // ROMs load and start here
+
+bool chip8_init(chip8_t *chip8, const chip8_config_t config, const char rom_name[]);
+bool chip8_init_rom(chip8_t *chip8, const chip8_config_t config, const uint8_t *rom, const size_t rom_size,
+                    const char rom_name[]);
+void chip8_emulate_instruction(chip8_t *chip8, const chip8_config_t config);
+void chip8_update_timers(chip8_t *chip8);
+uint64_t chip8_display_hash(const chip8_t *chip8);
+
+uint8_t *chip8_ram_write(chip8_t *chip8, const uint16_t addr);
+void chip8_load_ram(chip8_t *chip8, const uint8_t *src);
+void chip8_store_ram(const chip8_t *chip8, uint8_t *dst);
+
+size_t chip8_save_state(const chip8_t *chip8, uint8_t *buf);
+bool chip8_load_state(chip8_t *chip8, const uint8_t *buf, const size_t size);
+
+chip8_t *chip8_alloc(const size_t count);
+void chip8_free(chip8_t *chip8);
+
+bool chip8_pool_init(chip8_pool_t *pool, chip8_t *root, const uint32_t capacity);
+chip8_t *chip8_fork(chip8_pool_t *pool, const chip8_t *parent);
+void chip8_pool_release(chip8_pool_t *pool, chip8_t *child);
+void chip8_pool_free(chip8_pool_t *pool);
+
+bool chip8_trace_init(chip8_trace_t *trace, const uint32_t capacity);
+bool chip8_trace_write(chip8_trace_t *trace, const char *path);
+void chip8_trace_free(chip8_trace_t *trace);
+
+chip8_rewind_t *chip8_rewind_create(const uint32_t budget_mb);
+void chip8_rewind_free(chip8_rewind_t *rewind);
+void chip8_rewind_capture(chip8_rewind_t *rewind, chip8_t *chip8);
+bool chip8_rewind_step(chip8_rewind_t *rewind, chip8_t *chip8);
+
+#ifdef PROFILE
+chip8_profile_t *chip8_profile(void);
+void chip8_profile_merge(chip8_profile_t *dst, const chip8_profile_t *src);
+void chip8_profile_print(const chip8_profile_t *profile, FILE *out);
+bool chip8_profile_write_csv(const chip8_profile_t *profile, const char *path);
+
+void chip8_guest_profile_init(chip8_guest_profile_t *profile);
+void chip8_guest_profile_print(const chip8_guest_profile_t *profile, FILE *out, const uint32_t top);
+bool chip8_guest_profile_write_folded(const chip8_guest_profile_t *profile, const char *rom_name,
+                                      const char *path);
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_env.h"
+#include "chip8_internal.h"
+
+#define ENV_ALIGN(size) (((size) + 63) & ~(size_t)63)
+
+static size_t actions_offset(void)
+{
+    return ENV_ALIGN(sizeof(chip8_env_header_t));
+}
+
+static size_t observations_offset(const uint32_t count)
+{
+    return actions_offset() + ENV_ALIGN(count * sizeof(uint16_t));
+}
+
+static size_t rewards_offset(const uint32_t count)
+{
+    return observations_offset(count) + ENV_ALIGN((size_t)count * CHIP8_ENV_OBS_SIZE);
+}
+
+static size_t done_offset(const uint32_t count)
+{
+    return rewards_offset(count) + ENV_ALIGN(count * sizeof(int32_t));
+}
+
+size_t chip8_env_region_size(const uint32_t count)
+{
+    return done_offset(count) + ENV_ALIGN(count);
+}
+
+static int32_t read_score(const chip8_env_t *env, const chip8_t *chip8)
+{
+    if (env->config.reward_bytes == 2)
+        return chip8_ram_read(chip8, env->config.reward_addr) << 8 |
+               chip8_ram_read(chip8, env->config.reward_addr + 1);
+    if (env->config.reward_bytes == 1)
+        return chip8_ram_read(chip8, env->config.reward_addr);
+    return 0;
+}
+
+static void pack_observation(const chip8_t *chip8, uint8_t *out)
+{
+    uint32_t i, b;
+    for (i = 0; i < CHIP8_ENV_OBS_SIZE; ++i) {
+        uint8_t byte = 0;
+        for (b = 0; b < 8; ++b)
+            byte = byte << 1 | chip8->display[i * 8 + b];
+        out[i] = byte;
+    }
+}
+
+// Start a new episode on machine i, a copy-on-write fork of the loaded ROM
+static void reset_machine(chip8_env_t *env, const uint32_t i)
+{
+    if (env->machines[i])
+        chip8_pool_release(&env->pool, env->machines[i]);
+    chip8_t *chip8 = chip8_fork(&env->pool, &env->root);
+    env->machines[i] = chip8;
+
+    // Different CXNN stream per machine and per episode, still reproducible
+    chip8->rng_state += (uint64_t)(i + 1) * 0x9E3779B97F4A7C15ull +
+                        (uint64_t)env->episodes[i]++ * 0xD1B54A32D192ED03ull;
+
+    env->score[i] = read_score(env, chip8);
+    env->episode_steps[i] = 0;
+    env->rewards[i] = 0;
+    env->done[i] = 0;
+    pack_observation(chip8, &env->observations[i * CHIP8_ENV_OBS_SIZE]);
+}
+
+bool chip8_env_init(chip8_env_t *env, const chip8_env_config_t config, const char rom_name[],
+                    uint8_t *region)
+{
+    memset(env, 0, sizeof(chip8_env_t));
+    env->config = config;
+
+    if (config.count == 0 || config.frames_per_step == 0 || config.reward_bytes > 2) {
+        fprintf(stderr, "Invalid environment config\n");
+        return false;
+    }
+    if (!chip8_init(&env->root, config.core, rom_name))
+        return false;
+
+    env->machines = calloc(config.count, sizeof(chip8_t *));
+    env->score = calloc(config.count, sizeof(int32_t));
+    env->episode_steps = calloc(config.count, sizeof(uint32_t));
+    env->episodes = calloc(config.count, sizeof(uint32_t));
+    if (!env->machines || !env->score || !env->episode_steps || !env->episodes ||
+        !chip8_pool_init(&env->pool, &env->root, config.count)) {
+        fprintf(stderr, "Could not allocate %u environments\n", config.count);
+        chip8_env_free(env);
+        return false;
+    }
+
+    memset(region, 0, chip8_env_region_size(config.count));
+    env->region = region;
+    env->header = (chip8_env_header_t *)region;
+    *env->header = (chip8_env_header_t) {
+        .magic = CHIP8_ENV_MAGIC,
+        .version = CHIP8_ENV_VERSION,
+        .count = config.count,
+        .obs_size = CHIP8_ENV_OBS_SIZE,
+        .actions_offset = actions_offset(),
+        .observations_offset = observations_offset(config.count),
+        .rewards_offset = rewards_offset(config.count),
+        .done_offset = done_offset(config.count),
+    };
+    env->actions = (uint16_t *)&region[env->header->actions_offset];
+    env->observations = &region[env->header->observations_offset];
+    env->rewards = (int32_t *)&region[env->header->rewards_offset];
+    env->done = &region[env->header->done_offset];
+
+    chip8_env_reset(env);
+    return true;
+}
+
+void chip8_env_reset(chip8_env_t *env)
+{
+    uint32_t i;
+    for (i = 0; i < env->config.count; ++i)
+        reset_machine(env, i);
+}
+
+void chip8_env_step(chip8_env_t *env)
+{
+    const chip8_env_config_t *config = &env->config;
+    uint32_t i, f, n, k;
+
+    for (i = 0; i < config->count; ++i) {
+        // The consumer saw the final observation of the last episode, start the next
+        if (env->done[i])
+            reset_machine(env, i);
+
+        chip8_t *chip8 = env->machines[i];
+        const uint16_t action = env->actions[i];
+        for (k = 0; k < 16; ++k)
+            chip8->keypad[k] = (action >> k) & 1;
+
+        for (f = 0; f < config->frames_per_step; ++f) {
+            for (n = 0; n < config->insts_per_frame; ++n)
+                chip8_emulate_instruction(chip8, config->core);
+            chip8_update_timers(chip8);
+        }
+
+        const int32_t score = read_score(env, chip8);
+        env->rewards[i] = score - env->score[i];
+        env->score[i] = score;
+        env->episode_steps[i]++;
+        env->done[i] = (config->use_done_addr && chip8_ram_read(chip8, config->done_addr) == config->done_value) ||
+                       (config->max_steps && env->episode_steps[i] >= config->max_steps);
+        pack_observation(chip8, &env->observations[i * CHIP8_ENV_OBS_SIZE]);
+    }
+    env->header->steps++;
+}
+
+void chip8_env_free(chip8_env_t *env)
+{
+    chip8_pool_free(&env->pool);
+    free(env->machines);
+    free(env->score);
+    free(env->episode_steps);
+    free(env->episodes);
+    env->machines = NULL;
+}
@@ -0,0 +1,87 @@
+#ifndef CHIP8_ENV_H
+#define CHIP8_ENV_H
+
+#include "chip8_core.h"
+
+// Batched step/reset environment over N machines running one ROM, for
+// reinforcement learning. All inputs and outputs live in one flat region the
+// caller provides, so it can be shared memory mapped by the consumer:
+//
+//   header | actions[count] u16 | observations[count][256] | rewards[count] i32 | done[count] u8
+//
+// Actions are keypad bitmasks (bit n is key n) held for the whole step.
+// Observations are the display packed 1 bit per pixel, MSB first, row major.
+// The reward is the change of a big-endian score in RAM since the last step.
+// A machine is done when a RAM byte equals a value or the episode hits
+// max_steps, and is reset from the ROM image at the start of its next step.
+
+#define CHIP8_ENV_MAGIC     "C8EV"
+#define CHIP8_ENV_VERSION   1
+#define CHIP8_ENV_OBS_SIZE  (CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT / 8)
+
+typedef struct {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    count;
+    uint32_t    obs_size;
+    uint32_t    actions_offset;
+    uint32_t    observations_offset;
+    uint32_t    rewards_offset;
+    uint32_t    done_offset;
+    uint64_t    steps;              // step() calls since the region was created
+} chip8_env_header_t;
+
+typedef struct {
+    chip8_config_t  core;
+    uint32_t        count;
+    uint32_t        insts_per_frame;
+    uint32_t        frames_per_step;    // Frame skip, the action repeats on each
+    uint16_t        reward_addr;        // Score location in RAM
+    uint8_t         reward_bytes;       // 0 for no reward, 1 or 2
+    uint16_t        done_addr;          // Game over flag location in RAM
+    uint8_t         done_value;
+    bool            use_done_addr;
+    uint32_t        max_steps;          // Episode length limit, 0 for none
+} chip8_env_config_t;
+
+typedef struct {
+    chip8_env_config_t  config;
+    chip8_t             root;           // Freshly loaded ROM, every reset forks it
+    chip8_pool_t        pool;
+    chip8_t             **machines;
+    int32_t             *score;         // Score seen at the end of the last step
+    uint32_t            *episode_steps;
+    uint32_t            *episodes;      // Resets so far, varies the random seed
+    uint8_t             *region;
+    chip8_env_header_t  *header;
+    uint16_t            *actions;
+    uint8_t             *observations;
+    int32_t             *rewards;
+    uint8_t             *done;
+} chip8_env_t;
+
+// chip8-envd control messages over its UNIX socket. The client fills actions
+// in the shared region, sends a command and waits for the reply before
+// reading the outputs.
+enum {
+    CHIP8_ENV_STEP = 1,     // arg: steps to run with the same actions
+    CHIP8_ENV_RESET,
+    CHIP8_ENV_CLOSE,
+};
+
+typedef struct {
+    uint32_t    command;    // Reply: 0 on success
+    uint32_t    arg;        // Reply: low 32 bits of header.steps
+} chip8_env_message_t;
+
+size_t chip8_env_region_size(const uint32_t count);
+
+// region must be chip8_env_region_size(config.count) bytes, it is initialized here.
+// env must not move afterwards, its machines point into its own pool.
+bool chip8_env_init(chip8_env_t *env, const chip8_env_config_t config, const char rom_name[],
+                    uint8_t *region);
+void chip8_env_reset(chip8_env_t *env);
+void chip8_env_step(chip8_env_t *env);
+void chip8_env_free(chip8_env_t *env);
+
+#endif
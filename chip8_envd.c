@@ -0,0 +1,350 @@
+#define _POSIX_C_SOURCE 200809L // shm_open, clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "chip8_env.h"
+
+// chip8-envd: serves a chip8_env_t over POSIX shared memory (--shm) and a
+// UNIX socket (--socket). Observations, rewards and done flags are written
+// straight into the shared region, the socket only carries step/reset
+// commands. --bench N forks a client that runs N steps and reports steps/s.
+
+typedef struct {
+    chip8_env_config_t  env;
+    const char          *rom_name;
+    const char          *shm_name;
+    const char          *socket_path;
+    uint32_t            bench_steps;
+} envd_config_t;
+
+bool set_config_from_args(envd_config_t *config, const int argc, char **argv)
+{
+    *config = (envd_config_t) {
+        .env = {
+            .core.current_extension = CHIP8_EXT_CHIP8,
+            .count                  = 64,
+            .insts_per_frame        = 700 / 60,
+            .frames_per_step        = 4,
+        },
+        .rom_name       = argv[1],
+        .shm_name       = "/chip8-env",
+        .socket_path    = "/tmp/chip8-env.sock",
+    };
+
+    int i;
+    for (i = 2; i < argc; ++i) {
+        if (strncmp(argv[i], "--envs", strlen("--envs")) == 0 && i + 1 < argc)
+            config->env.count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--shm", strlen("--shm")) == 0 && i + 1 < argc)
+            config->shm_name = argv[++i];
+        else if (strncmp(argv[i], "--socket", strlen("--socket")) == 0 && i + 1 < argc)
+            config->socket_path = argv[++i];
+        else if (strncmp(argv[i], "--frames-per-step", strlen("--frames-per-step")) == 0 && i + 1 < argc)
+            config->env.frames_per_step = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--insts-per-frame", strlen("--insts-per-frame")) == 0 && i + 1 < argc)
+            config->env.insts_per_frame = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--reward-addr", strlen("--reward-addr")) == 0 && i + 1 < argc) {
+            config->env.reward_addr = (uint16_t)strtoul(argv[++i], NULL, 0);
+            if (config->env.reward_bytes == 0)
+                config->env.reward_bytes = 1;
+        } else if (strncmp(argv[i], "--reward-bytes", strlen("--reward-bytes")) == 0 && i + 1 < argc)
+            config->env.reward_bytes = (uint8_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--done-addr", strlen("--done-addr")) == 0 && i + 1 < argc) {
+            config->env.done_addr = (uint16_t)strtoul(argv[++i], NULL, 0);
+            config->env.use_done_addr = true;
+        } else if (strncmp(argv[i], "--done-value", strlen("--done-value")) == 0 && i + 1 < argc)
+            config->env.done_value = (uint8_t)strtoul(argv[++i], NULL, 0);
+        else if (strncmp(argv[i], "--max-steps", strlen("--max-steps")) == 0 && i + 1 < argc)
+            config->env.max_steps = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--seed", strlen("--seed")) == 0 && i + 1 < argc)
+            config->env.core.seed = strtoull(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--bench", strlen("--bench")) == 0 && i + 1 < argc)
+            config->bench_steps = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--extension", strlen("--extension")) == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "chip8") == 0)
+                config->env.core.current_extension = CHIP8_EXT_CHIP8;
+            else if (strcmp(argv[i], "superchip") == 0)
+                config->env.core.current_extension = CHIP8_EXT_SUPERCHIP;
+            else if (strcmp(argv[i], "xochip") == 0)
+                config->env.core.current_extension = CHIP8_EXT_XOCHIP;
+            else {
+                fprintf(stderr, "Unknown extension %s\n", argv[i]);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    if (config->env.reward_bytes > 2 || config->env.reward_addr > 0xFFF ||
+        config->env.done_addr > 0xFFF) {
+        fprintf(stderr, "--reward-bytes must be 1 or 2, RAM addresses at most 0xFFF\n");
+        return false;
+    }
+    if (strlen(config->socket_path) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", config->socket_path);
+        return false;
+    }
+    return true;
+}
+
+bool read_full(const int fd, void *buf, const size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = read(fd, (uint8_t *)buf + done, size - done);
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+bool write_full(const int fd, const void *buf, const size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = write(fd, (const uint8_t *)buf + done, size - done);
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+// Handle one client until it closes or disconnects, false on CHIP8_ENV_CLOSE
+bool serve_client(chip8_env_t *env, const int client)
+{
+    chip8_env_message_t message;
+    while (read_full(client, &message, sizeof(message))) {
+        uint32_t status = 0;
+        uint32_t s;
+        switch (message.command) {
+        case CHIP8_ENV_STEP:
+            for (s = 0; s < (message.arg ? message.arg : 1); ++s)
+                chip8_env_step(env);
+            break;
+        case CHIP8_ENV_RESET:
+            chip8_env_reset(env);
+            break;
+        case CHIP8_ENV_CLOSE:
+            return false;
+        default:
+            status = 1;
+            break;
+        }
+
+        const chip8_env_message_t reply = {.command = status, .arg = (uint32_t)env->header->steps};
+        if (!write_full(client, &reply, sizeof(reply)))
+            break;
+    }
+    return true;
+}
+
+double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Client side of --bench: map the region, step with changing actions, report
+int run_bench_client(const envd_config_t *config, const size_t region_size)
+{
+    const int shm = shm_open(config->shm_name, O_RDWR, 0);
+    uint8_t *region = shm < 0 ? MAP_FAILED : mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+    const int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, config->socket_path);
+    if (region == MAP_FAILED || sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Bench client could not attach to %s / %s\n", config->shm_name, config->socket_path);
+        return EXIT_FAILURE;
+    }
+
+    const chip8_env_header_t *header = (const chip8_env_header_t *)region;
+    uint16_t *actions = (uint16_t *)&region[header->actions_offset];
+    const int32_t *rewards = (const int32_t *)&region[header->rewards_offset];
+    const uint8_t *done = &region[header->done_offset];
+
+    chip8_env_message_t message = {.command = CHIP8_ENV_RESET}, reply;
+    write_full(sock, &message, sizeof(message));
+    read_full(sock, &reply, sizeof(reply));
+
+    int64_t reward_sum = 0;
+    uint64_t episodes = 0;
+    uint32_t s, i;
+    const double start = now_s();
+    for (s = 0; s < config->bench_steps; ++s) {
+        for (i = 0; i < header->count; ++i)
+            actions[i] = 1 << ((s + i) & 0xF);
+
+        message = (chip8_env_message_t) {.command = CHIP8_ENV_STEP, .arg = 1};
+        if (!write_full(sock, &message, sizeof(message)) || !read_full(sock, &reply, sizeof(reply)) ||
+            reply.command != 0) {
+            fprintf(stderr, "Bench step %u failed\n", s);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < header->count; ++i) {
+            reward_sum += rewards[i];
+            episodes += done[i];
+        }
+    }
+    const double seconds = now_s() - start;
+
+    const double env_steps = (double)config->bench_steps * header->count;
+    printf("%u envs x %u steps in %.3f s: %.0f env steps/s, %.0f frames/s, %.1f us per batch round trip, "
+           "%lld reward, %llu episodes ended\n",
+           header->count, config->bench_steps, seconds, env_steps / seconds,
+           env_steps * config->env.frames_per_step / seconds, seconds * 1e6 / config->bench_steps,
+           (long long)reward_sum, (long long unsigned)episodes);
+
+    message = (chip8_env_message_t) {.command = CHIP8_ENV_CLOSE};
+    write_full(sock, &message, sizeof(message));
+    close(sock);
+    munmap(region, region_size);
+    close(shm);
+    return EXIT_SUCCESS;
+}
+
+// True if a server accepts connections on addr. A socket file nobody listens
+// on is left over from a server that crashed and may be replaced.
+bool socket_in_use(const struct sockaddr_un *addr)
+{
+    const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0)
+        return false;
+    const bool live = connect(probe, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+    close(probe);
+    return live;
+}
+
+// Wait for the --bench client to connect. False, with its wait status, if it
+// exited first, for example because it could not attach to the region.
+bool wait_for_bench_client(const int listener, const pid_t bench, int *status)
+{
+    struct pollfd pfd = {.fd = listener, .events = POLLIN};
+    for (;;) {
+        const int ready = poll(&pfd, 1, 100);
+        // accept() picks up the client, or the error
+        if (ready > 0 || (ready < 0 && errno != EINTR))
+            return true;
+        if (waitpid(bench, status, WNOHANG) == bench)
+            return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <rom_name> [--envs N] [--shm /name] [--socket path] "
+                        "[--frames-per-step N] [--insts-per-frame N] [--reward-addr A] [--reward-bytes 1|2] "
+                        "[--done-addr A] [--done-value V] [--max-steps N] [--seed N] "
+                        "[--extension chip8|superchip|xochip] [--bench steps]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    envd_config_t config;
+    if (!set_config_from_args(&config, argc, argv))
+        exit(EXIT_FAILURE);
+
+    // Never take the socket or shared memory name over from a live server
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, config.socket_path);
+    if (socket_in_use(&addr)) {
+        fprintf(stderr, "Socket %s is already in use by a running server\n", config.socket_path);
+        exit(EXIT_FAILURE);
+    }
+
+    // Shared region, the consumer maps the same name
+    const size_t region_size = chip8_env_region_size(config.env.count);
+    const int shm = shm_open(config.shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (shm < 0 && errno == EEXIST) {
+        fprintf(stderr, "Shared memory %s is already in use, pick another --shm or remove "
+                        "/dev/shm%s if its server is gone\n", config.shm_name, config.shm_name);
+        exit(EXIT_FAILURE);
+    }
+    if (shm < 0) {
+        fprintf(stderr, "Could not create shared memory %s\n", config.shm_name);
+        exit(EXIT_FAILURE);
+    }
+    // From here on every failure removes the name again
+    if (ftruncate(shm, region_size) != 0) {
+        fprintf(stderr, "Could not size shared memory %s\n", config.shm_name);
+        shm_unlink(config.shm_name);
+        exit(EXIT_FAILURE);
+    }
+    uint8_t *region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+    if (region == MAP_FAILED) {
+        fprintf(stderr, "Could not map shared memory %s\n", config.shm_name);
+        shm_unlink(config.shm_name);
+        exit(EXIT_FAILURE);
+    }
+
+    // Holds a cache line aligned chip8_t
+    chip8_env_t *env = aligned_alloc(_Alignof(chip8_env_t), sizeof(chip8_env_t));
+    if (!env || !chip8_env_init(env, config.env, config.rom_name, region)) {
+        shm_unlink(config.shm_name);
+        exit(EXIT_FAILURE);
+    }
+
+    // Nothing answered on the socket above, so any file there is stale
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(config.socket_path);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, 1) != 0) {
+        fprintf(stderr, "Could not listen on %s\n", config.socket_path);
+        shm_unlink(config.shm_name);
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t bench = -1;
+    if (config.bench_steps) {
+        bench = fork();
+        if (bench == 0)
+            exit(run_bench_client(&config, region_size));
+    } else {
+        printf("Serving %u environments on %s, shared memory %s (%zu bytes)\n",
+               config.env.count, config.socket_path, config.shm_name, region_size);
+        fflush(stdout);
+    }
+
+    // One client at a time; --bench stops after its client, otherwise CHIP8_ENV_CLOSE stops
+    int status = EXIT_SUCCESS;
+    bool running = true;
+    while (running) {
+        if (bench > 0 && !wait_for_bench_client(listener, bench, &status)) {
+            fprintf(stderr, "Bench client exited without connecting\n");
+            bench = -1;
+            status = EXIT_FAILURE;
+            break;
+        }
+        const int client = accept(listener, NULL, NULL);
+        if (client < 0)
+            break;
+        running = serve_client(env, client) && bench < 0;
+        close(client);
+    }
+
+    if (bench > 0)
+        waitpid(bench, &status, 0);
+
+    close(listener);
+    unlink(config.socket_path);
+    chip8_env_free(env);
+    free(env);
+    munmap(region, region_size);
+    close(shm);
+    shm_unlink(config.shm_name);
+    return status == EXIT_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
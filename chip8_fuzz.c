@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chip8_core.h"
+
+// Fuzz target for the instruction core. Build with -DLIBFUZZER for libFuzzer,
+// with afl-clang-fast for AFL (persistent mode over stdin), or plainly to
+// replay inputs given as arguments or to time --bench N random inputs.
+//
+// Input: byte 0 picks the extension, bytes 1-2 are the held keypad bitmask,
+// the rest is the ROM. Every run starts from a copy-on-write fork of one
+// pristine machine, so a reset is a ~2 KB memcpy instead of chip8_init().
+
+#ifndef FUZZ_INSTRUCTIONS
+#define FUZZ_INSTRUCTIONS 1000
+#endif
+#define FUZZ_INSTS_PER_FRAME 11
+#define FUZZ_HEADER 3
+
+static chip8_t pristine;
+static chip8_pool_t pool;
+static bool pool_ready;
+
+static bool abort_on_hazard = true;   // --bench counts them and ends the run instead
+static uint64_t hazards;
+
+// Invariants the sanitizers cannot see: the stack index and FX0A key live
+// inside chip8_t, and chip8_load_state() rejects a PC past the address space
+static bool check_machine(const chip8_t *chip8)
+{
+    if (chip8->stack_ptr >= CHIP8_STACK_SIZE || chip8->PC > CHIP8_ADDR_MASK ||
+        (chip8->fx0a_key > 0xF && chip8->fx0a_key != 0xFF)) {
+        if (abort_on_hazard) {
+            fprintf(stderr, "Machine out of range: PC 0x%04X, stack index %u, FX0A key 0x%02X\n",
+                    chip8->PC, chip8->stack_ptr, chip8->fx0a_key);
+            abort();
+        }
+        return false;
+    }
+    return true;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (!pool_ready) {
+        const uint8_t empty = 0;
+        chip8_init_rom(&pristine, (chip8_config_t){0}, &empty, 0, "fuzz");
+        if (!chip8_pool_init(&pool, &pristine, 1))
+            abort();
+        pool_ready = true;
+    }
+
+    if (size < FUZZ_HEADER || size - FUZZ_HEADER > CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT)
+        return 0;
+
+    const chip8_config_t config = {.current_extension = (chip8_extension_t)(data[0] % 3)};
+    chip8_t *chip8 = chip8_fork(&pool, &pristine);
+
+    const uint16_t keys = data[1] | data[2] << 8;
+    uint32_t i;
+    for (i = 0; i < 16; ++i)
+        chip8->keypad[i] = (keys >> i) & 1;
+    for (i = 0; i < size - FUZZ_HEADER; ++i)
+        *chip8_ram_write(chip8, CHIP8_ENTRY_POINT + i) = data[FUZZ_HEADER + i];
+
+    // Stop early once the ROM spins on one instruction (halt loops, FX0A)
+    for (i = 0; i < FUZZ_INSTRUCTIONS; ++i) {
+        const uint16_t PC = chip8->PC;
+        chip8_emulate_instruction(chip8, config);
+        if (!check_machine(chip8)) {
+            hazards++;
+            break;
+        }
+        if (i % FUZZ_INSTS_PER_FRAME == FUZZ_INSTS_PER_FRAME - 1)
+            chip8_update_timers(chip8);
+        if (chip8->PC == PC)
+            break;
+    }
+
+    chip8_pool_release(&pool, chip8);
+    return 0;
+}
+
+#ifndef LIBFUZZER
+// Random inputs, mostly short ROMs, to measure executions per second
+static int run_bench(const uint32_t runs)
+{
+    static uint8_t input[FUZZ_HEADER + 512];
+    uint64_t state = 0x853C49E6748FEA9Bull;
+    uint64_t bytes = 0;
+    abort_on_hazard = false;
+
+    const clock_t start = clock();
+    uint32_t r;
+    for (r = 0; r < runs; ++r) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        const size_t size = FUZZ_HEADER + (state >> 32) % (sizeof(input) - FUZZ_HEADER);
+
+        size_t i;
+        for (i = 0; i < size; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            input[i] = (uint8_t)state;
+        }
+        bytes += size;
+        LLVMFuzzerTestOneInput(input, size);
+    }
+    const double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%u executions in %.2f s, %.0f exec/s, average input %.0f bytes, up to %u instructions each\n",
+           runs, seconds, runs / seconds, (double)bytes / runs, FUZZ_INSTRUCTIONS);
+    printf("%llu runs ended on a broken invariant\n", (long long unsigned)hazards);
+    return EXIT_SUCCESS;
+}
+
+static size_t read_input(FILE *file, uint8_t *buf, const size_t capacity)
+{
+    size_t size = 0, n;
+    while (size < capacity && (n = fread(buf + size, 1, capacity - size, file)) > 0)
+        size += n;
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buf[FUZZ_HEADER + CHIP8_RAM_SIZE];
+
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0)
+        return run_bench((uint32_t)strtoul(argv[2], NULL, 10));
+
+    // Replay crashers and corpus files
+    int i;
+    for (i = 1; i < argc; ++i) {
+        FILE *file = fopen(argv[i], "rb");
+        if (!file) {
+            fprintf(stderr, "Could not open %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        const size_t size = read_input(file, buf, sizeof(buf));
+        fclose(file);
+        LLVMFuzzerTestOneInput(buf, size);
+    }
+    if (argc > 1)
+        return EXIT_SUCCESS;
+
+    // AFL: one input per loop iteration on stdin
+#ifdef __AFL_LOOP
+    while (__AFL_LOOP(100000))
+#endif
+        LLVMFuzzerTestOneInput(buf, read_input(stdin, buf, sizeof(buf)));
+    return EXIT_SUCCESS;
+}
+#endif
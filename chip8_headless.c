@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "chip8_core.h"
+#include "chip8_audio.h"
+
+// Runs a ROM on libchip8 alone, no SDL, and prints a hash of the final display.
+// Useful for regression runs on machines without a display or audio device.
+// Guest MIPS goes to stderr so stdout stays identical across runs.
+// --wav records the audio the SDL frontend would have played, on emulated
+// time, so the file can be hashed and compared across builds.
+
+typedef struct {
+    chip8_config_t  core;
+    uint32_t        insts_per_sec;
+    uint32_t        frames;
+    const char      *wav_path;
+    uint32_t        sample_rate;
+    uint32_t        square_wave_freq;
+    int16_t         volume;
+} headless_config_t;
+
+// The emulation thread renders into blocks and a writer thread streams them
+// to disk. The queue grows instead of waiting when the writer falls behind,
+// so neither samples nor emulation time are ever lost.
+#define WAV_BLOCK_SAMPLES   32768
+#define WAV_QUEUE_SIZE      64
+
+typedef struct {
+    int16_t     *samples;
+    uint32_t    count;
+    uint32_t    capacity;
+} wav_block_t;
+
+typedef struct {
+    FILE                *file;
+    pthread_t           thread;
+    sem_t               ready;          // One post per queued block, plus one at close
+    wav_block_t         queue[WAV_QUEUE_SIZE];
+    atomic_uint         head;           // Written by the emulation thread
+    atomic_uint         tail;           // Written by the writer thread
+    atomic_bool         closing;
+    wav_block_t         current;        // Block being filled by the emulation thread
+    uint32_t            sample_rate;
+    uint64_t            samples_written;
+    bool                write_failed;
+} wav_sink_t;
+
+double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Canonical 44 byte PCM header, sizes are patched in close_wav_sink()
+bool write_wav_header(FILE *file, const uint32_t sample_rate, const uint32_t data_size)
+{
+    const uint32_t byte_rate = sample_rate * sizeof(int16_t);
+    const uint8_t header[44] = {
+        'R', 'I', 'F', 'F',
+        (data_size + 36) & 0xFF, ((data_size + 36) >> 8) & 0xFF,
+        ((data_size + 36) >> 16) & 0xFF, ((data_size + 36) >> 24) & 0xFF,
+        'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0,
+        1, 0,                                           // PCM
+        1, 0,                                           // Mono
+        sample_rate & 0xFF, (sample_rate >> 8) & 0xFF,
+        (sample_rate >> 16) & 0xFF, (sample_rate >> 24) & 0xFF,
+        byte_rate & 0xFF, (byte_rate >> 8) & 0xFF,
+        (byte_rate >> 16) & 0xFF, (byte_rate >> 24) & 0xFF,
+        sizeof(int16_t), 0,                             // Block align
+        16, 0,                                          // Bits per sample
+        'd', 'a', 't', 'a',
+        data_size & 0xFF, (data_size >> 8) & 0xFF,
+        (data_size >> 16) & 0xFF, (data_size >> 24) & 0xFF,
+    };
+
+    return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+void *wav_writer_thread(void *data)
+{
+    wav_sink_t *wav = (wav_sink_t *)data;
+
+    for (;;) {
+        sem_wait(&wav->ready);
+
+        uint32_t tail = atomic_load(&wav->tail);
+        const uint32_t head = atomic_load(&wav->head);
+
+        while (tail != head) {
+            wav_block_t *block = &wav->queue[tail % WAV_QUEUE_SIZE];
+            if (fwrite(block->samples, sizeof(int16_t), block->count, wav->file) != block->count)
+                wav->write_failed = true;
+            free(block->samples);
+            atomic_store(&wav->tail, ++tail);
+        }
+
+        if (atomic_load(&wav->closing) && tail == atomic_load(&wav->head))
+            return NULL;
+    }
+}
+
+bool open_wav_sink(wav_sink_t *wav, const char *path, const uint32_t sample_rate)
+{
+    *wav = (wav_sink_t) {.sample_rate = sample_rate};
+    atomic_init(&wav->head, 0);
+    atomic_init(&wav->tail, 0);
+    atomic_init(&wav->closing, false);
+
+    wav->file = fopen(path, "wb");
+    if (!wav->file) {
+        fprintf(stderr, "Could not open WAV file %s\n", path);
+        return false;
+    }
+
+    if (!write_wav_header(wav->file, sample_rate, 0)) {
+        fprintf(stderr, "Could not write WAV header to %s\n", path);
+        fclose(wav->file);
+        return false;
+    }
+
+    if (sem_init(&wav->ready, 0, 0) != 0) {
+        fprintf(stderr, "Could not create WAV writer semaphore\n");
+        fclose(wav->file);
+        return false;
+    }
+
+    if (pthread_create(&wav->thread, NULL, wav_writer_thread, wav) != 0) {
+        fprintf(stderr, "Could not start WAV writer thread\n");
+        sem_destroy(&wav->ready);
+        fclose(wav->file);
+        return false;
+    }
+
+    return true;
+}
+
+// Hand the current block to the writer thread if there is room, otherwise keep growing it
+void flush_wav_block(wav_sink_t *wav)
+{
+    const uint32_t head = atomic_load(&wav->head);
+    const uint32_t tail = atomic_load(&wav->tail);
+
+    if (wav->current.count == 0 || head - tail >= WAV_QUEUE_SIZE)
+        return;
+
+    wav->queue[head % WAV_QUEUE_SIZE] = wav->current;
+    wav->current = (wav_block_t) {0};
+    atomic_store(&wav->head, head + 1);
+    sem_post(&wav->ready);
+}
+
+// Space for count samples at the end of the current block, NULL if out of memory
+int16_t *reserve_wav_samples(wav_sink_t *wav, const uint32_t count)
+{
+    wav_block_t *block = &wav->current;
+
+    if (block->count >= WAV_BLOCK_SAMPLES)
+        flush_wav_block(wav);
+
+    if (block->count + count > block->capacity) {
+        const uint32_t capacity = block->capacity + (count > WAV_BLOCK_SAMPLES ? count : WAV_BLOCK_SAMPLES);
+        int16_t *samples = realloc(block->samples, capacity * sizeof(int16_t));
+        if (!samples)
+            return NULL;
+        block->samples = samples;
+        block->capacity = capacity;
+    }
+
+    int16_t *out = &block->samples[block->count];
+    block->count += count;
+    wav->samples_written += count;
+    return out;
+}
+
+// Render audio up to emulated sample time end, the caller then applies the
+// edge or pattern change that happens at end
+bool render_wav_until(wav_sink_t *wav, chip8_audio_t *audio, const uint64_t end)
+{
+    if (end <= wav->samples_written)
+        return true;
+
+    const uint32_t count = (uint32_t)(end - wav->samples_written);
+    int16_t *out = reserve_wav_samples(wav, count);
+    if (!out) {
+        fprintf(stderr, "Out of memory buffering WAV audio\n");
+        return false;
+    }
+
+    chip8_audio_render(audio, out, count);
+    return true;
+}
+
+bool close_wav_sink(wav_sink_t *wav)
+{
+    // Writer drains the queue first, then the remaining block is written here
+    atomic_store(&wav->closing, true);
+    sem_post(&wav->ready);
+    pthread_join(wav->thread, NULL);
+    sem_destroy(&wav->ready);
+
+    bool ok = !wav->write_failed;
+    if (wav->current.count &&
+        fwrite(wav->current.samples, sizeof(int16_t), wav->current.count, wav->file) != wav->current.count)
+        ok = false;
+    free(wav->current.samples);
+
+    const uint64_t data_size = wav->samples_written * sizeof(int16_t);
+    if (data_size > UINT32_MAX - 36) {
+        fprintf(stderr, "WAV output exceeds 4 GB, header sizes are invalid\n");
+        ok = false;
+    }
+
+    rewind(wav->file);
+    ok = write_wav_header(wav->file, wav->sample_rate, (uint32_t)data_size) && ok;
+    ok = (fclose(wav->file) == 0) && ok;
+
+    if (!ok)
+        fprintf(stderr, "Could not write WAV file\n");
+    return ok;
+}
+
+bool set_config_from_args(headless_config_t *config, const int argc, char **argv)
+{
+    *config = (headless_config_t) {
+        .core.current_extension = CHIP8_EXT_CHIP8,
+        .insts_per_sec          = 700,
+        .frames                 = 600,
+        .sample_rate            = 44100,
+        .square_wave_freq       = 440,
+        .volume                 = 3000,
+    };
+
+    int i;
+    for (i = 2; i < argc; ++i) {
+        if (strncmp(argv[i], "--frames", strlen("--frames")) == 0 && i + 1 < argc)
+            config->frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--insts-per-sec", strlen("--insts-per-sec")) == 0 && i + 1 < argc)
+            config->insts_per_sec = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--seed", strlen("--seed")) == 0 && i + 1 < argc)
+            config->core.seed = strtoull(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--wav", strlen("--wav")) == 0 && i + 1 < argc)
+            config->wav_path = argv[++i];
+        else if (strncmp(argv[i], "--sample-rate", strlen("--sample-rate")) == 0 && i + 1 < argc)
+            config->sample_rate = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--extension", strlen("--extension")) == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "chip8") == 0)
+                config->core.current_extension = CHIP8_EXT_CHIP8;
+            else if (strcmp(argv[i], "superchip") == 0)
+                config->core.current_extension = CHIP8_EXT_SUPERCHIP;
+            else if (strcmp(argv[i], "xochip") == 0)
+                config->core.current_extension = CHIP8_EXT_XOCHIP;
+            else {
+                fprintf(stderr, "Unknown extension %s\n", argv[i]);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    if (config->insts_per_sec < 60) {
+        fprintf(stderr, "--insts-per-sec must be at least 60\n");
+        return false;
+    }
+
+    if (config->sample_rate < 8000 || config->sample_rate > 192000) {
+        fprintf(stderr, "--sample-rate must be between 8000 and 192000 Hz\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <rom_name> [--frames N] [--insts-per-sec N] "
+                        "[--seed N] [--extension chip8|superchip|xochip] [--wav PATH] [--sample-rate N]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    headless_config_t config;
+    if (!set_config_from_args(&config, argc, argv))
+        exit(EXIT_FAILURE);
+
+    chip8_t *chip8 = chip8_alloc(1);
+    if (!chip8 || !chip8_init(chip8, config.core, argv[1]))
+        exit(EXIT_FAILURE);
+#ifdef PROFILE
+    static chip8_guest_profile_t guest_profile;
+    chip8_guest_profile_init(&guest_profile);
+    chip8->guest_profile = &guest_profile;
+#endif
+#ifdef DEBUG
+    chip8_trace_t trace;
+    if (!chip8_trace_init(&trace, 1 << 20))
+        exit(EXIT_FAILURE);
+    chip8->trace = &trace;
+#endif
+
+    // Sound timer edges and pattern changes take effect at the emulated
+    // sample time of the instruction that caused them
+    wav_sink_t wav;
+    chip8_audio_t audio;
+    if (config.wav_path) {
+        if (!open_wav_sink(&wav, config.wav_path, config.sample_rate))
+            exit(EXIT_FAILURE);
+        chip8_audio_init(&audio, config.sample_rate, config.square_wave_freq, config.volume,
+                         config.core.current_extension);
+    }
+
+    const uint32_t insts_per_frame = config.insts_per_sec / 60;
+    uint64_t instructions = 0;
+    uint32_t sound_frames = 0;
+    uint32_t frame, i;
+    bool ok = true;
+    const double start = now_ms();
+    for (frame = 0; ok && frame < config.frames; ++frame) {
+        for (i = 0; i < insts_per_frame; ++i) {
+            chip8_emulate_instruction(chip8, config.core);
+
+            if (config.wav_path && (chip8->audio_changed || (chip8->sound_timer > 0) != audio.gate)) {
+                ok = render_wav_until(&wav, &audio,
+                                      chip8_audio_sample_time(audio.sample_rate, frame, i + 1, insts_per_frame)) && ok;
+                chip8_audio_set_pattern(&audio, chip8->audio_pattern, chip8->pitch);
+                audio.gate = chip8->sound_timer > 0;
+                chip8->audio_changed = false;
+            }
+        }
+        instructions += insts_per_frame;
+
+        if (chip8->sound_timer > 0)
+            sound_frames++;
+        chip8_update_timers(chip8);
+
+        // Sound timer ran out on this tick
+        if (config.wav_path) {
+            ok = render_wav_until(&wav, &audio,
+                                  chip8_audio_sample_time(audio.sample_rate, frame + 1, 0, insts_per_frame)) && ok;
+            audio.gate = chip8->sound_timer > 0;
+        }
+    }
+    const double seconds = (now_ms() - start) / 1e3;
+
+    if (config.wav_path && !close_wav_sink(&wav))
+        ok = false;
+
+    printf("%s frames %u instructions %llu sound_frames %u display %016llx\n",
+           argv[1], config.frames, (long long unsigned)instructions, sound_frames,
+           (long long unsigned)chip8_display_hash(chip8));
+    fprintf(stderr, "%s %.1f guest MIPS over %.3f s\n", argv[1], instructions / seconds / 1e6, seconds);
+#ifdef PROFILE
+    chip8_profile_print(chip8_profile(), stderr);
+    chip8_profile_write_csv(chip8_profile(), "chip8_profile.csv");
+    chip8_guest_profile_print(&guest_profile, stderr, 20);
+    chip8_guest_profile_write_folded(&guest_profile, argv[1], "chip8_guest.folded");
+#endif
+#ifdef DEBUG
+    chip8_trace_write(&trace, "chip8.trace");
+    chip8_trace_free(&trace);
+#endif
+
+    chip8_free(chip8);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
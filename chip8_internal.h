@@ -0,0 +1,46 @@
+#ifndef CHIP8_INTERNAL_H
+#define CHIP8_INTERNAL_H
+
+#include "chip8_core.h"
+
+// libchip8 internals shared by chip8_core.c, chip8_soa.c and chip8_env.c.
+// Frontends and tools include chip8_core.h only.
+
+// Guest controlled indexes, RAM addresses included, are masked into range.
+// -DCHIP8_UNCHECKED drops the masks, the bench links such a build of
+// chip8_core.c as the reference for what they cost.
+#ifdef CHIP8_UNCHECKED
+#define GUEST_INDEX(value, mask) (value)
+#else
+#define GUEST_INDEX(value, mask) ((value) & (mask))
+#endif
+
+// Read guest RAM, addresses wrap at 4 KB
+static inline uint8_t chip8_ram_read(const chip8_t *chip8, const uint16_t addr)
+{
+    return chip8->ram_page[GUEST_INDEX(addr >> 8, CHIP8_RAM_PAGES - 1)][addr & (CHIP8_RAM_PAGE_SIZE - 1)];
+}
+
+#define DIRTY_PAGE_SHIFT 6
+
+// Mark the RAM pages covering [addr, addr + len) as written
+#define MARK_RAM_DIRTY(chip8, addr, len) \
+    ((chip8)->ram_dirty |= (1ull << (((addr) >> DIRTY_PAGE_SHIFT) & 63)) | \
+                           (1ull << ((((addr) + (len) - 1) >> DIRTY_PAGE_SHIFT) & 63)))
+
+// Rewind history: one record per frame holding the XOR of that frame's state
+// against the previous one, run-length encoded as [u16 offset][u8 len][len bytes].
+// Records sit in a byte ring as [u32 len][runs][u32 len] so the newest can be
+// popped from the head and the oldest evicted from the tail.
+struct chip8_rewind {
+    uint8_t     *buf;
+    size_t      capacity;
+    size_t      head;                       // Next write position
+    size_t      used;
+    uint32_t    frames;
+    uint8_t     shadow[CHIP8_STATE_SIZE];   // Packed state as of the newest record
+    uint8_t     scratch[CHIP8_STATE_SIZE * 2];
+    bool        primed;                     // shadow holds a captured state
+};
+
+#endif
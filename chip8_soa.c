@@ -0,0 +1,385 @@
+#include <string.h>
+#include "chip8_soa.h"
+#include "chip8_internal.h"
+
+#define LANES CHIP8_SOA_LANES
+
+// Copy one lane's registers into its chip8_t
+static void store_lane(const chip8_soa_t *soa, const uint32_t lane)
+{
+    chip8_t *chip8 = soa->machine[lane];
+    uint32_t r;
+    for (r = 0; r < 16; ++r) {
+        chip8->V[r] = soa->V[r][lane];
+        chip8->keypad[r] = (soa->keys[lane] >> r) & 1;
+    }
+    chip8->I = soa->I[lane];
+    chip8->PC = soa->PC[lane];
+    chip8->delay_timer = soa->delay_timer[lane];
+    chip8->sound_timer = soa->sound_timer[lane];
+    chip8->rng_state = soa->rng_state[lane];
+}
+
+static void load_lane(chip8_soa_t *soa, const uint32_t lane)
+{
+    const chip8_t *chip8 = soa->machine[lane];
+    uint32_t r;
+    soa->keys[lane] = 0;
+    for (r = 0; r < 16; ++r) {
+        soa->V[r][lane] = chip8->V[r];
+        soa->keys[lane] |= (uint16_t)chip8->keypad[r] << r;
+    }
+    soa->I[lane] = chip8->I;
+    soa->PC[lane] = chip8->PC;
+    soa->delay_timer[lane] = chip8->delay_timer;
+    soa->sound_timer[lane] = chip8->sound_timer;
+    soa->rng_state[lane] = chip8->rng_state;
+
+    // A page is shared when it is lane 0's read-only pristine page, typically
+    // from forking every lane off one root
+    const chip8_t *first = soa->machine[0];
+    soa->own_pages[lane] = chip8->ram_private_mask | first->ram_private_mask;
+    for (r = 0; r < CHIP8_RAM_PAGES; ++r)
+        if (chip8->ram_page[r] != first->ram_page[r])
+            soa->own_pages[lane] |= 1 << r;
+}
+
+void chip8_soa_load(chip8_soa_t *soa, chip8_t *const machines[], const uint32_t count)
+{
+    memset(soa, 0, sizeof(chip8_soa_t));
+    soa->lanes = count < LANES ? count : LANES;
+
+    uint32_t lane;
+    for (lane = 0; lane < soa->lanes; ++lane) {
+        soa->machine[lane] = machines[lane];
+        load_lane(soa, lane);
+    }
+}
+
+void chip8_soa_store(const chip8_soa_t *soa)
+{
+    uint32_t lane;
+    for (lane = 0; lane < soa->lanes; ++lane)
+        store_lane(soa, lane);
+}
+
+// Lanes in mask run the opcode on their own chip8_t
+static void step_scalar(chip8_soa_t *soa, const uint8_t *mask, const chip8_config_t config)
+{
+    uint32_t lane;
+    for (lane = 0; lane < soa->lanes; ++lane) {
+        if (!mask[lane])
+            continue;
+        store_lane(soa, lane);
+        chip8_emulate_instruction(soa->machine[lane], config);
+        load_lane(soa, lane);
+    }
+}
+
+// DXYN on one lane, same clipping as the scalar core
+static void draw_sprite(chip8_soa_t *soa, const uint32_t lane, const uint8_t vx, const uint8_t vy,
+                        const uint8_t rows)
+{
+    chip8_t *chip8 = soa->machine[lane];
+    const uint8_t x = vx % CHIP8_DISPLAY_WIDTH;
+    uint8_t y = vy % CHIP8_DISPLAY_HEIGHT;
+    uint8_t collision = 0;
+
+    uint8_t i;
+    for (i = 0; i < rows && y < CHIP8_DISPLAY_HEIGHT; ++i, ++y) {
+        const uint8_t sprite_data = chip8_ram_read(chip8, (uint16_t)(soa->I[lane] + i));
+        bool *row = &chip8->display[y * CHIP8_DISPLAY_WIDTH];
+        uint8_t j;
+        for (j = 0; j < 8 && x + j < CHIP8_DISPLAY_WIDTH; ++j) {
+            const bool sprite_bit = (sprite_data >> (7 - j)) & 1;
+            collision |= sprite_bit & row[x + j];
+            row[x + j] ^= sprite_bit;
+        }
+    }
+    soa->V[0xF][lane] = collision;
+    chip8->draw = true;
+    chip8->display_dirty = true;
+}
+
+// Run one opcode on the lanes in mask (0xFF in, 0x00 out). Every loop below
+// is branch-free over lanes so it vectorizes with blends on the mask.
+static void step_group(chip8_soa_t *soa, const uint16_t opcode, const uint8_t *mask,
+                       const chip8_config_t config)
+{
+    const uint16_t NNN = opcode & 0x0FFF;
+    const uint8_t NN = opcode & 0xFF;
+    const uint8_t N = opcode & 0x0F;
+    uint8_t *VX = soa->V[(opcode >> 8) & 0x0F];
+    uint8_t *VY = soa->V[(opcode >> 4) & 0x0F];
+    uint8_t *VF = soa->V[0xF];
+    uint16_t *PC = soa->PC;
+    const bool chip8_quirks = config.current_extension == CHIP8_EXT_CHIP8;
+    uint32_t l;
+
+    switch (opcode >> 12) {
+    case 0x1:
+        for (l = 0; l < LANES; ++l)
+            PC[l] = mask[l] ? NNN : PC[l];
+        return;
+
+    case 0x3:
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & (VX[l] == NN ? 4 : 2);
+        return;
+
+    case 0x4:
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & (VX[l] != NN ? 4 : 2);
+        return;
+
+    case 0x5:
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & (N == 0 && VX[l] == VY[l] ? 4 : 2);
+        return;
+
+    case 0x6:
+        for (l = 0; l < LANES; ++l) {
+            PC[l] += mask[l] & 2;
+            VX[l] = mask[l] ? NN : VX[l];
+        }
+        return;
+
+    case 0x7:
+        for (l = 0; l < LANES; ++l) {
+            PC[l] += mask[l] & 2;
+            VX[l] += mask[l] & NN;
+        }
+        return;
+
+    case 0x8:
+        // VF is written after VX so it wins when X is F, as in the scalar core
+        switch (N) {
+        case 0x0:
+            for (l = 0; l < LANES; ++l)
+                VX[l] = mask[l] ? VY[l] : VX[l];
+            break;
+
+        case 0x1:
+        case 0x2:
+        case 0x3:
+            for (l = 0; l < LANES; ++l) {
+                const uint8_t x = VX[l], y = VY[l];
+                const uint8_t r = N == 1 ? x | y : N == 2 ? x & y : x ^ y;
+                VX[l] = mask[l] ? r : x;
+                if (chip8_quirks)
+                    VF[l] = mask[l] ? 0 : VF[l];
+            }
+            break;
+
+        case 0x4:
+            for (l = 0; l < LANES; ++l) {
+                const uint8_t x = VX[l], y = VY[l];
+                const uint8_t r = x + y;
+                VX[l] = mask[l] ? r : x;
+                VF[l] = mask[l] ? r < x : VF[l];
+            }
+            break;
+
+        case 0x5:
+            for (l = 0; l < LANES; ++l) {
+                const uint8_t x = VX[l], y = VY[l];
+                VX[l] = mask[l] ? (uint8_t)(x - y) : x;
+                VF[l] = mask[l] ? y <= x : VF[l];
+            }
+            break;
+
+        case 0x6:
+            for (l = 0; l < LANES; ++l) {
+                const uint8_t src = chip8_quirks ? VY[l] : VX[l];
+                VX[l] = mask[l] ? src >> 1 : VX[l];
+                VF[l] = mask[l] ? src & 1 : VF[l];
+            }
+            break;
+
+        case 0x7:
+            for (l = 0; l < LANES; ++l) {
+                const uint8_t x = VX[l], y = VY[l];
+                VX[l] = mask[l] ? (uint8_t)(y - x) : x;
+                VF[l] = mask[l] ? x <= y : VF[l];
+            }
+            break;
+
+        case 0xE:
+            for (l = 0; l < LANES; ++l) {
+                const uint8_t src = chip8_quirks ? VY[l] : VX[l];
+                VX[l] = mask[l] ? (uint8_t)(src << 1) : VX[l];
+                VF[l] = mask[l] ? src >> 7 : VF[l];
+            }
+            break;
+
+        default:
+            break;
+        }
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & 2;
+        return;
+
+    case 0x9:
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & (VX[l] != VY[l] ? 4 : 2);
+        return;
+
+    case 0xA:
+        for (l = 0; l < LANES; ++l) {
+            PC[l] += mask[l] & 2;
+            soa->I[l] = mask[l] ? NNN : soa->I[l];
+        }
+        return;
+
+    case 0xB:
+        for (l = 0; l < LANES; ++l)
+            PC[l] = mask[l] ? soa->V[0][l] + NNN : PC[l];
+        return;
+
+    case 0xC:
+        // PCG32, same stream as chip8_random()
+        for (l = 0; l < LANES; ++l) {
+            const uint64_t old = soa->rng_state[l];
+            const uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+            const uint32_t rot = old >> 59;
+            const uint32_t random = (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+
+            soa->rng_state[l] = mask[l] ? old * 6364136223846793005ull + 1442695040888963407ull : old;
+            VX[l] = mask[l] ? (random & NN) : VX[l];
+            PC[l] += mask[l] & 2;
+        }
+        return;
+
+    case 0xD:
+        for (l = 0; l < soa->lanes; ++l)
+            if (mask[l])
+                draw_sprite(soa, l, VX[l], VY[l], N);
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & 2;
+        return;
+
+    case 0xE:
+        if (NN != 0x9E && NN != 0xA1)
+            break;
+        for (l = 0; l < LANES; ++l) {
+            const bool pressed = (soa->keys[l] >> (VX[l] & 0xF)) & 1;
+            PC[l] += mask[l] & (pressed == (NN == 0x9E) ? 4 : 2);
+        }
+        return;
+
+    case 0xF:
+        switch (NN) {
+        case 0x07:
+            for (l = 0; l < LANES; ++l)
+                VX[l] = mask[l] ? soa->delay_timer[l] : VX[l];
+            break;
+        case 0x15:
+            for (l = 0; l < LANES; ++l)
+                soa->delay_timer[l] = mask[l] ? VX[l] : soa->delay_timer[l];
+            break;
+        case 0x18:
+            for (l = 0; l < LANES; ++l)
+                soa->sound_timer[l] = mask[l] ? VX[l] : soa->sound_timer[l];
+            break;
+        case 0x1E:
+            for (l = 0; l < LANES; ++l)
+                soa->I[l] += mask[l] ? VX[l] : 0;
+            break;
+        case 0x29:
+            for (l = 0; l < LANES; ++l)
+                soa->I[l] = mask[l] ? VX[l] * 5 : soa->I[l];
+            break;
+        default:
+            step_scalar(soa, mask, config);
+            return;
+        }
+        for (l = 0; l < LANES; ++l)
+            PC[l] += mask[l] & 2;
+        return;
+
+    default:
+        break;
+    }
+
+    step_scalar(soa, mask, config);
+}
+
+// Up to UINT16_MAX instructions per lane, so budgets and PCs share a vector width
+static void run_chunk(chip8_soa_t *soa, const chip8_config_t config, const uint16_t count)
+{
+    _Alignas(64) uint16_t budget[LANES];
+    _Alignas(64) uint8_t mask[LANES];
+    _Alignas(64) uint8_t fetch[LANES];
+    uint32_t l;
+
+    for (l = 0; l < LANES; ++l)
+        budget[l] = l < soa->lanes ? count : 0;
+
+    // Always run the lowest PC among lanes with instructions left. Lanes that
+    // branched ahead wait there, so the others catch up and the groups merge
+    // again instead of staying split for the rest of the run.
+    for (;;) {
+        uint16_t min_pc = UINT16_MAX;
+        for (l = 0; l < LANES; ++l) {
+            const uint16_t pc = budget[l] ? soa->PC[l] : UINT16_MAX;
+            min_pc = pc < min_pc ? pc : min_pc;
+        }
+        if (min_pc == UINT16_MAX)
+            break;
+
+        // Lanes sharing the code pages with the leader hold the same opcode,
+        // only the rest read their own RAM
+        uint32_t leader = 0;
+        while (!budget[leader] || soa->PC[leader] != min_pc)
+            leader++;
+        const uint16_t opcode = chip8_ram_read(soa->machine[leader], min_pc) << 8 |
+                                chip8_ram_read(soa->machine[leader], min_pc + 1);
+        const uint16_t code_pages = 1 << ((min_pc >> 8) & (CHIP8_RAM_PAGES - 1)) |
+                                    1 << (((min_pc + 1) >> 8) & (CHIP8_RAM_PAGES - 1));
+        const uint16_t leader_pages = soa->own_pages[leader] & code_pages;
+
+        uint16_t any_fetch = 0;
+        for (l = 0; l < LANES; ++l) {
+            const bool at_pc = budget[l] && soa->PC[l] == min_pc;
+            mask[l] = at_pc ? 0xFF : 0;
+            fetch[l] = at_pc && ((soa->own_pages[l] & code_pages) | leader_pages);
+            any_fetch |= fetch[l];
+        }
+
+        // Lanes whose code differs at this PC wait for a later pass
+        if (any_fetch) {
+            for (l = 0; l < soa->lanes; ++l) {
+                if (l == leader || !fetch[l])
+                    continue;
+                const chip8_t *chip8 = soa->machine[l];
+                if ((chip8_ram_read(chip8, min_pc) << 8 | chip8_ram_read(chip8, min_pc + 1)) != opcode)
+                    mask[l] = 0;
+            }
+        }
+        for (l = 0; l < LANES; ++l)
+            budget[l] -= mask[l] & 1;
+        step_group(soa, opcode, mask, config);
+
+        // Wrap at 4 KB as chip8_emulate_instruction() does
+        for (l = 0; l < LANES; ++l)
+            soa->PC[l] &= CHIP8_ADDR_MASK;
+    }
+}
+
+void chip8_soa_run(chip8_soa_t *soa, const chip8_config_t config, uint32_t count)
+{
+    while (count > 0) {
+        const uint16_t chunk = count < UINT16_MAX ? count : UINT16_MAX;
+        run_chunk(soa, config, chunk);
+        count -= chunk;
+    }
+}
+
+void chip8_soa_update_timers(chip8_soa_t *soa)
+{
+    uint32_t l;
+    for (l = 0; l < LANES; ++l) {
+        soa->delay_timer[l] -= soa->delay_timer[l] > 0;
+        soa->sound_timer[l] -= soa->sound_timer[l] > 0;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef CHIP8_SOA_H
+#define CHIP8_SOA_H
+
+#include "chip8_core.h"
+
+// Lockstep execution of many machines running the same ROM. The register file
+// of every lane sits in structure-of-arrays form so one instruction runs over
+// all lanes as plain loops the compiler turns into AVX2/AVX-512 code. Each step
+// the lanes at the lowest PC run as one masked group, which lets lanes that
+// took different branches converge again.
+//
+// RAM, display, stack and the remaining state stay in each lane's chip8_t.
+// DXYN draws lane by lane, the other opcodes touching that state (00E0, 00EE,
+// 2NNN, FX0A, FX33, FX55, FX65, F002, FX3A) run through chip8_emulate_instruction().
+
+#ifndef CHIP8_SOA_LANES
+#define CHIP8_SOA_LANES 32
+#endif
+
+typedef struct {
+    uint8_t                 V[16][CHIP8_SOA_LANES];
+    uint16_t                I[CHIP8_SOA_LANES];
+    uint16_t                PC[CHIP8_SOA_LANES];
+    uint16_t                keys[CHIP8_SOA_LANES];      // Keypad bitmask, bit n is key n
+    uint64_t                rng_state[CHIP8_SOA_LANES];
+    uint8_t                 delay_timer[CHIP8_SOA_LANES];
+    uint8_t                 sound_timer[CHIP8_SOA_LANES];
+    uint16_t                own_pages[CHIP8_SOA_LANES]; // RAM pages that may differ from other lanes
+    chip8_t                 *machine[CHIP8_SOA_LANES];
+    uint32_t                lanes;                      // Lanes in use, the rest idle
+} chip8_soa_t;
+
+// Take over up to CHIP8_SOA_LANES machines. Their registers are stale until
+// chip8_soa_store(), their display and RAM are always current.
+void chip8_soa_load(chip8_soa_t *soa, chip8_t *const machines[], const uint32_t count);
+void chip8_soa_store(const chip8_soa_t *soa);
+
+// Run count instructions on every lane, like count chip8_emulate_instruction() calls
+void chip8_soa_run(chip8_soa_t *soa, const chip8_config_t config, uint32_t count);
+void chip8_soa_update_timers(chip8_soa_t *soa);
+
+#endif
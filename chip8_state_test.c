@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_core.h"
+
+// Savestate tests: save -> load -> save must reproduce the blob byte for byte,
+// and no single flipped bit or byte may load into a machine that breaks the
+// core's invariants. Corrupted blobs are tried as is and with their checksum
+// fixed up, so the field validation is exercised and not just the checksum.
+
+static uint32_t failures;
+static const uint8_t empty_rom = 0;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); failures++; } } while (0)
+
+// Same as state_checksum() in chip8_core.c
+static uint32_t adler32(const uint8_t *data, const size_t size)
+{
+    uint32_t a = 1, b = 0;
+    size_t i;
+    for (i = 0; i < size; ++i) {
+        a += data[i];
+        b += a;
+    }
+    return ((b % 65521) << 16) | (a % 65521);
+}
+
+static void restamp(uint8_t *buf)
+{
+    const uint32_t checksum = adler32(buf + CHIP8_STATE_HEADER, CHIP8_STATE_SIZE - CHIP8_STATE_HEADER);
+    buf[8] = checksum & 0xFF;
+    buf[9] = (checksum >> 8) & 0xFF;
+    buf[10] = (checksum >> 16) & 0xFF;
+    buf[11] = checksum >> 24;
+}
+
+static bool machine_valid(const chip8_t *chip8)
+{
+    return chip8->stack_ptr < CHIP8_STACK_SIZE && chip8->PC <= CHIP8_ADDR_MASK &&
+           (chip8->fx0a_key <= 0xF || chip8->fx0a_key == 0xFF) &&
+           chip8->fx0a_key_pressed == (chip8->fx0a_key != 0xFF);
+}
+
+static void test_round_trip(const char *name, const chip8_t *chip8)
+{
+    static uint8_t first[CHIP8_STATE_SIZE], second[CHIP8_STATE_SIZE];
+    chip8_t *loaded = chip8_alloc(1);
+    if (!loaded)
+        abort();
+    chip8_init_rom(loaded, (chip8_config_t){0}, &empty_rom, 0, "blank");
+
+    CHECK(chip8_save_state(chip8, first) == CHIP8_STATE_SIZE, "%s: short save", name);
+    CHECK(chip8_load_state(loaded, first, sizeof(first)), "%s: valid blob rejected", name);
+    chip8_save_state(loaded, second);
+    CHECK(memcmp(first, second, sizeof(first)) == 0, "%s: save -> load -> save differs", name);
+    CHECK(machine_valid(loaded), "%s: loaded machine out of range", name);
+    chip8_free(loaded);
+}
+
+// Returns how many corrupted blobs were accepted
+static uint32_t load_corrupted(const char *name, const uint8_t *blob, const uint8_t *corrupted, chip8_t *target,
+                               const size_t offset)
+{
+    static uint8_t before[CHIP8_STATE_SIZE], after[CHIP8_STATE_SIZE];
+    chip8_save_state(target, before);
+
+    if (!chip8_load_state(target, corrupted, CHIP8_STATE_SIZE)) {
+        chip8_save_state(target, after);
+        CHECK(memcmp(before, after, sizeof(before)) == 0, "%s: rejected blob at offset %zu changed the machine",
+              name, offset);
+        return 0;
+    }
+    CHECK(machine_valid(target), "%s: corruption at offset %zu loaded an invalid machine "
+          "(PC 0x%04X, stack index %u, FX0A key 0x%02X pressed %u)", name, offset,
+          target->PC, target->stack_ptr, target->fx0a_key, target->fx0a_key_pressed);
+
+    // Reset for the next case
+    chip8_load_state(target, blob, CHIP8_STATE_SIZE);
+    return 1;
+}
+
+static void test_corruption(const char *name, const chip8_t *chip8)
+{
+    static uint8_t blob[CHIP8_STATE_SIZE], corrupted[CHIP8_STATE_SIZE];
+    chip8_save_state(chip8, blob);
+
+    chip8_t *target = chip8_alloc(1);
+    if (!target)
+        abort();
+    chip8_init_rom(target, (chip8_config_t){0}, &empty_rom, 0, "blank");
+    chip8_load_state(target, blob, sizeof(blob));
+
+    uint32_t raw_accepted = 0, restamped_accepted = 0;
+    size_t offset;
+    uint32_t bit;
+    for (offset = 0; offset < CHIP8_STATE_SIZE; ++offset) {
+        // Every single bit flip, then the whole byte inverted
+        for (bit = 0; bit <= 8; ++bit) {
+            memcpy(corrupted, blob, sizeof(blob));
+            corrupted[offset] ^= bit < 8 ? 1 << bit : 0xFF;
+            raw_accepted += load_corrupted(name, blob, corrupted, target, offset);
+
+            // Any RAM or display byte is valid, only the registers need range checks
+            if (offset >= CHIP8_STATE_REGS) {
+                restamp(corrupted);
+                restamped_accepted += load_corrupted(name, blob, corrupted, target, offset);
+            }
+        }
+    }
+    CHECK(raw_accepted == 0, "%s: %u corrupted blobs passed the checksum", name, raw_accepted);
+    printf("%-24s %u corrupted blobs with a fixed checksum loaded, all in range\n", name, restamped_accepted);
+    chip8_free(target);
+}
+
+int main(void)
+{
+    chip8_t *chip8 = chip8_alloc(1);
+    if (!chip8)
+        return EXIT_FAILURE;
+    const chip8_config_t config = {.seed = 7};
+
+    // Fresh machine
+    chip8_init_rom(chip8, config, &empty_rom, 0, "blank");
+    test_round_trip("fresh", chip8);
+    test_corruption("fresh", chip8);
+
+    // Two calls deep, something drawn, delay timer and RNG state set
+    const uint8_t calls[] = {
+        0x22, 0x04,     // 200: CALL 0x204
+        0x12, 0x00,     // 202: JP 0x200
+        0x22, 0x08,     // 204: CALL 0x208
+        0x22, 0x0C,     // 206: CALL 0x20C (not reached)
+        0x60, 0x3C,     // 208: LD V0, 60
+        0xF0, 0x15,     // 20A: LD DT, V0
+        0xA0, 0x00,     // 20C: LD I, 0
+        0xD0, 0x15,     // 20E: DRW V0, V1, 5
+        0xCF, 0xFF,     // 210: RND VF, 0xFF
+        0x12, 0x10,     // 212: JP 0x210
+    };
+    chip8_init_rom(chip8, config, calls, sizeof(calls), "calls");
+    uint32_t i;
+    for (i = 0; i < 40; ++i)
+        chip8_emulate_instruction(chip8, config);
+    test_round_trip("calls", chip8);
+    test_corruption("calls", chip8);
+
+    // FX0A with key 5 latched and still held
+    const uint8_t wait_key[] = {0xF3, 0x0A, 0x12, 0x00};
+    chip8_init_rom(chip8, config, wait_key, sizeof(wait_key), "fx0a");
+    chip8->keypad[5] = true;
+    chip8_emulate_instruction(chip8, config);
+    CHECK(chip8->fx0a_key == 5 && chip8->fx0a_key_pressed, "fx0a: key not latched");
+    test_round_trip("fx0a latched", chip8);
+    test_corruption("fx0a latched", chip8);
+
+    chip8_free(chip8);
+    if (failures) {
+        fprintf(stderr, "%u savestate checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    puts("All savestate checks passed");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_core.h"
+
+// Decodes a trace written by the DEBUG build into one line per instruction,
+// prefixed with its cycle and followed by the register it left behind.
+
+// The description the DEBUG build used to print live, from the state the record kept
+static void print_record(const chip8_trace_record_t *r)
+{
+    const chip8_instruction_t inst = {
+        .opcode = r->opcode,
+        .NNN    = r->opcode & 0x0FFF,
+        .NN     = r->opcode & 0x0FF,
+        .N      = r->opcode & 0x0F,
+        .X      = (r->opcode >> 8) & 0x0F,
+        .Y      = (r->opcode >> 4) & 0x0F,
+    };
+
+    printf("Address: 0x%04X, Opcode: 0x%04X, Desc: ", 
+            r->PC, r->opcode);
+    switch ((r->opcode >> 12) & 0x0F) {
+    case 0x00:
+        if (inst.NN == 0xE0) {
+            // 00E0: Clears the screen
+            printf("Clear screen\n");
+        }
+        else if (inst.NN == 0xEE) {
+            // 00EE: Returns from subrutine
+            printf("Return from subrutine to address: 0x%04X\n",
+                    r->aux);
+        }
+        else 
+        {
+            printf("Unimplemented instuction\n");
+        }      
+        break;
+
+    case 0x01:
+        // 1NNN: Jumps to address NNN
+        printf("Jump to address NNN (0x%04X)\n", inst.NNN);
+        break;
+
+    case 0x02:
+        // 2NNN: Calls subrutine at NNN
+        printf("Call subroutine at NNN (0x%04X)\n", inst.NNN);
+        break;
+
+    case 0x03:
+        // 3XNN: Skips the next instruction if VX equals NN
+        printf("Check if V%X (0x%02X) == NN (0x%02X), skip next instruction if true\n",
+                inst.X, r->VX, inst.NN);
+        break;
+
+    case 0x04:
+        // 4XNN: Skips the next instruction if VX != NN
+        printf("Check if V%X (0x%02X) != NN (0x%02X), skip next instruction if true\n",
+                inst.X, r->VX, inst.NN);
+        break;
+
+    case 0x05:
+        // 5XY0: Skips the next instruction if VX == VY
+        printf("Check if V%X (0x%02X) == V%X (0x%02X), skip next instruction if true\n",
+                inst.X, r->VX, inst.Y, r->VY);
+        break;
+
+    case 0x06:
+        // 6XNN: Sets VX to NN
+        printf("Set V%X = NN (0x%02X)\n", inst.X, inst.NN);
+        break;
+    
+    case 0x07:
+        // 7XNN: Adds NN to VX (carry flag is not changed)
+        printf("Set V%X (0x%02X) += NN (0x%02X), Result: 0x%02X\n", 
+                inst.X, r->VX, inst.NN, 
+                r->VX + inst.NN);
+        break;
+
+    case 0x08:
+        switch (inst.N) {
+        case 0x0:
+            // 8XY0: Sets VX to the value of VY
+            printf("Set register V%X = V%X (0x%02X)\n", 
+                    inst.X, inst.Y, r->VY);
+            break;
+        
+        case 0x1:
+            // 8XY1: Sets VX to VX or VY
+                printf("Set register V%X (0x%02X) |= V%X (0x%02X): Result: 0x%02X\n", 
+                        inst.X, r->VX,
+                        inst.Y, r->VY,
+                        r->VX | r->VY);
+            break;
+        
+        case 0x2:
+            // 8XY2: Sets VX to VX and VY
+            printf("Set register V%X (0x%02X) &= V%X (0x%02X): Result: 0x%02X\n", 
+                        inst.X, r->VX,
+                        inst.Y, r->VY,
+                        r->VX & r->VY);
+            break;
+        
+        case 0x3:
+            // 8XY3: Sets VX to VX xor VY
+            printf("Set register V%X (0x%02X) ^= V%X (0x%02X): Result: 0x%02X\n", 
+                        inst.X, r->VX,
+                        inst.Y, r->VY,
+                        r->VX ^ r->VY);
+            break;
+        
+        case 0x4:
+            // 8XY4: Adds VY to VX
+            // VF is set to 1 when there's a carry, and to 0 when there is not 
+            printf("Set register V%X (0x%02X) += V%X (0x%02X), VF = 1 if carry: Result: 0x%02X, VF = %X\n", 
+                        inst.X, r->VX,
+                        inst.Y, r->VY,
+                        r->VX + r->VY,
+                        ((uint16_t)r->VX + r->VY) > 255);
+            break;
+        
+        case 0x5:
+            // 8XY5: VY is subtracted from VX
+            // VF is set to 0 when there's a borrow, and 1 when there is not
+            printf("Set register V%X (0x%02X) -= V%X (0x%02X), VF = 1 if carry: Result: 0x%02X, VF = %X\n", 
+                    inst.X, r->VX,
+                    inst.Y, r->VY,
+                    r->VX - r->VY,
+                    r->VY <= r->VX);
+            break;
+        
+        case 0x6:
+            // 8XY6: Stores the most significant bit of VX in VF
+            // and then shifts VX to the left by 1
+            printf("Set register V%X (0x%02X) >>= 1, VF = shifted off bit (%X): Result: 0x%02X\n", 
+                    inst.X, r->VX,
+                    r->VX & 1,
+                    r->VX >> 1);
+            break;
+        
+        case 0x7:
+            // 8XY7: Sets VX to VY minus VX. VF is set to 0 
+            // when there's a borrow, and 1 when there is not.
+            printf("Set register V%X = V%X (0x%02X) - V%X (0x%02X), VF = 1 if no borrow: Result: 0x%02X, VF = %X\n", 
+                    inst.X, inst.Y, r->VY,
+                    inst.X, r->VX,
+                    r->VY - r->VX,
+                    r->VX <= r->VY);
+            break;
+        
+        case 0xE:
+            // 8XYE: Stores the most significant bit of VX in VF 
+            // and then shifts VX to the left by 1.
+            printf("Set register V%X (0x%02X) <<= 1, VF = shifted off bit (%X): Result: 0x%02X\n", 
+                    inst.X, r->VX,
+                    (r->VX & 0x80) >> 7,
+                    r->VX << 1);
+            break;
+
+        default:
+            // Wrong or unimplemented opcode
+            break;
+        }
+        break;
+
+    case 0x09:
+        // 9XY0: Skips the next instruction if VX does not equal VY
+        printf("Check if V%X (0x%02X) != V%X (0x%02X), skip next instruction if true\n",
+                inst.X, r->VX, inst.Y, r->VY);
+        break;
+
+    case 0x0A:
+        // ANNN: Sets I to the address NNN
+        printf("Set I to NNN (0x%04X)\n", inst.NNN);
+        break;
+
+    case 0x0B:
+        // ANNN: Jumps to the address NNN plus V0
+        printf("Set PC to V0 (0x%02X) + NNN (0x%04X): Result: PC = 0x%04X\n",
+                r->aux, inst.NNN, r->aux + inst.NNN);
+        break;
+
+    case 0x0C:
+        // CNNN: Sets VX to the result of a bitwise and 
+        // operation on a random number (Typically: 0 to 255) and NN. 
+        printf("Set V%X = random byte & NN (0x%02X)\n",
+                inst.X, inst.NN);
+        break;   
+
+     case 0x0D:
+        // DXYN: Draws a sprite at coordinate (VX, VY) that. 
+        // Read from location I.
+        // Screen pixels are XOR'd with sprite bits,
+        // VF (Carry Flag) is set if any screen pixels are set off.
+        printf("Draw N (%u) height sprite at coords V%X (0x%02X), V%X (0x%02X) "
+                "from memory location I (0x%04X). Set VF = 1 if any pixels are turned off.\n",
+                inst.N, inst.X, r->VX, inst.Y, 
+                r->VY, r->I);
+        break;
+
+    case 0x0E:
+        switch (inst.NN) {
+        case 0x9E:
+            // EX9E: Skips the next instruction if the key stored in VX is pressed
+            printf("Skip next instruction if key in V%X (0x%02X) is pressed: Keypad value: %d\n",
+                    inst.X, r->VX, r->aux);
+            break;
+        case 0xA1:
+            // EXA1: Skips the next instruction if the key stored in VX is not pressed
+            printf("Skip next instruction if key in V%X (0x%02X) is not pressed: Keypad value: %d\n",
+                    inst.X, r->VX, r->aux);
+   
+            break;
+        
+        default:
+            // No opcode
+            break;
+        }
+        break;
+
+    case 0x0F:
+        switch (inst.NN) {
+        case 0x02:
+            // F002: Loads the 16 byte audio pattern buffer from memory at I (XO-CHIP)
+            printf("Load audio pattern from memory at I (0x%04X)\n", r->I);
+            break;
+
+        case 0x07:
+            // FX07: Sets VX to the value of the delay timer
+            printf("Set V%X = delay timer value (0x%02X)\n",
+                    inst.X, r->aux);
+            break;
+        
+        case 0x0A:
+            // FX0A: A key press is awaited, and then stored in VX
+            printf("Await until a key is pressed, store key in V%X\n", inst.X);
+            break;
+
+        case 0x15:
+            // FX15: Sets the delay timer to VX
+            printf("Set delay timer value = V%X (0x%02X)\n",
+                    inst.X, r->VX);
+            break;
+
+        case 0x18:
+            // FX18: Sets the sound timer to VX
+            printf("Set sound timer value = V%X (0x%02X)\n",
+                    inst.X, r->VX);
+            break;
+
+        case 0x1E:
+            // FX1E: Adds VX to I. VF is not affected.
+            printf("I (0x%04X) += V%X (0x%02X): Result (I): 0x%04X\n",
+                    r->I, inst.X, r->VX,
+                    r->I + r->VX);
+            break;
+
+        case 0x3A:
+            // FX3A: Sets the audio pattern playback pitch to VX (XO-CHIP)
+            printf("Set audio pitch = V%X (0x%02X)\n",
+                    inst.X, r->VX);
+            break;
+
+        case 0x29:
+            // FX29: Sets I to the location of the sprite for the character in VX.
+            // Characters 0-F (in hexadecimal) are represented by a 4x5 font. 
+            printf("Set I to sprite location in memory for character in V%X (0x%02X). Result (VX * 5) = (0x%02X)\n",
+                    inst.X, r->VX, r->VX * 5);
+            break;
+
+        case 0x33:
+            // FX33: Stores the binary-coded decimal representation of VX,
+            // with the hundreds digit in memory at location in I,
+            // the tens digit at location I+1, and the ones digit at location I+2.
+            printf("Store BCD representation of V%X (0x%02X) at memory from I (0x%04X)\n",
+                    inst.X, r->VX, r->I); 
+            break;
+
+        case 0x55:
+            // FX55: Stores from V0 to VX (including VX) in memory, starting at address I.
+            // The offset from I is increased by 1 for each value written,
+            // but I itself is left unmodified (SCHIP).
+            printf("Register dump V0-V%X (0x%02X) inclusive at memory from I (0x%04X)\n",
+                    inst.X, r->VX, r->I); 
+            break;
+
+        case 0x65:
+            // FX65: Fills from V0 to VX (including VX) with values from memory, starting at address I.
+            // The offset from I is increased by 1 for each value read, but I itself is left unmodified
+            printf("Register load V0-V%X (0x%02X) inclusive at memory from I (0x%04X)\n",
+                    inst.X, r->VX, r->I); 
+            break;
+        
+        default:
+            // No opcode
+            break;
+        }
+        break;
+
+    default:
+        printf("Unimplemented instuction\n");
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace file> [--last N]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t last = UINT32_MAX;
+    int i;
+    for (i = 2; i < argc; ++i) {
+        if (strncmp(argv[i], "--last", strlen("--last")) == 0 && i + 1 < argc)
+            last = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open trace file %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    chip8_trace_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, CHIP8_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CHIP8_TRACE_VERSION || header.record_size != sizeof(chip8_trace_record_t)) {
+        fprintf(stderr, "%s is not a version %u CHIP8 trace\n", argv[1], CHIP8_TRACE_VERSION);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t skip = header.count > last ? header.count - last : 0;
+    if (skip && fseek(file, (long)skip * sizeof(chip8_trace_record_t), SEEK_CUR) != 0) {
+        fprintf(stderr, "Could not seek in trace file %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Records are consecutive, each keeps only the low 32 bits of its cycle
+    chip8_trace_record_t record;
+    uint32_t n;
+    for (n = skip; n < header.count && fread(&record, sizeof(record), 1, file) == 1; ++n) {
+        const uint64_t cycle = header.first_cycle + n;
+        if (record.cycle != (uint32_t)cycle)
+            fprintf(stderr, "Record %u has cycle %u, expected %u\n", n, record.cycle, (uint32_t)cycle);
+
+        printf("[%llu] ", (long long unsigned)cycle);
+        print_record(&record);
+        if (record.VX_after != record.VX)
+            printf("    -> V%X = 0x%02X\n", (record.opcode >> 8) & 0x0F, record.VX_after);
+        if ((record.opcode >> 12) == 0x8 || (record.opcode >> 12) == 0xD)
+            printf("    -> VF = 0x%02X\n", record.VF_after);
+    }
+
+    fclose(file);
+    if (n < header.count) {
+        fprintf(stderr, "Trace file %s is truncated after %u of %u records\n", argv[1], n, header.count);
+        exit(EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+}
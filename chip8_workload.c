@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_core.h"
+
+// Generates deterministic synthetic ROMs with one controlled instruction mix
+// each, for measuring core throughput. Unlike games they never wait on keys
+// or timers, they loop forever over roughly 3.5 KB of straight code. Run them
+// through chip8_headless with a high --insts-per-sec, it reports guest MIPS.
+
+#define WORKLOAD_CAPACITY   (CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT)
+#define WORKLOAD_UNIT_MAX   16      // Largest unit any mix emits, in bytes
+#define WORKLOAD_CALL_DEPTH 6       // Subroutine levels below main, well inside the 16 entry stack
+#define WORKLOAD_CALL_WIDTH 8       // Subroutines per level
+
+typedef struct {
+    uint8_t     rom[WORKLOAD_CAPACITY];
+    uint32_t    size;
+    uint64_t    rng;
+} workload_t;
+
+typedef void (*generate_t)(workload_t *w);
+
+static uint16_t here(const workload_t *w)
+{
+    return CHIP8_ENTRY_POINT + w->size;
+}
+
+static void emit(workload_t *w, const uint16_t opcode)
+{
+    w->rom[w->size++] = opcode >> 8;
+    w->rom[w->size++] = opcode & 0xFF;
+}
+
+static void patch(workload_t *w, const uint16_t addr, const uint16_t opcode)
+{
+    w->rom[addr - CHIP8_ENTRY_POINT] = opcode >> 8;
+    w->rom[addr - CHIP8_ENTRY_POINT + 1] = opcode & 0xFF;
+}
+
+// Room for another unit plus the jump that closes the loop
+static bool room(const workload_t *w)
+{
+    return w->size + WORKLOAD_UNIT_MAX + 2 <= WORKLOAD_CAPACITY;
+}
+
+// xorshift64, below n
+static uint32_t random_below(workload_t *w, const uint32_t n)
+{
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+    return (uint32_t)((w->rng >> 32) % n);
+}
+
+// Register ops that never touch I, memory or the PC. VF is left out as a
+// destination so the carry outputs are not immediately overwritten.
+static void emit_alu(workload_t *w)
+{
+    const uint16_t alu_ops[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+    const uint16_t X = random_below(w, 15), Y = random_below(w, 16);
+
+    switch (random_below(w, 4)) {
+    case 0:
+        emit(w, 0x6000 | X << 8 | random_below(w, 256));
+        break;
+    case 1:
+        emit(w, 0x7000 | X << 8 | random_below(w, 256));
+        break;
+    default:
+        emit(w, 0x8000 | X << 8 | Y << 4 | alu_ops[random_below(w, sizeof(alu_ops) / sizeof(alu_ops[0]))]);
+        break;
+    }
+}
+
+static void generate_alu(workload_t *w)
+{
+    while (room(w))
+        emit_alu(w);
+}
+
+// Random positions and heights 1-15 over 16 bytes of sprite data, with the
+// occasional clear so the screen does not settle into a fixed pattern
+static void generate_sprite(workload_t *w)
+{
+    const uint16_t data = CHIP8_ENTRY_POINT + 2;
+    emit(w, 0x1000 | (data + 16));
+    uint32_t i;
+    for (i = 0; i < 8; ++i)
+        emit(w, random_below(w, 0x10000));
+
+    while (room(w)) {
+        emit(w, 0xA000 | (data + random_below(w, 2)));
+        emit(w, 0x6000 | random_below(w, 64));
+        emit(w, 0x6100 | random_below(w, 32));
+        emit(w, 0xD010 | (1 + random_below(w, 15)));
+        if (random_below(w, 32) == 0)
+            emit(w, 0x00E0);
+    }
+}
+
+// A fixed tree of subroutines, deepest level first so every CALL target is
+// already known. Each does a little ALU work and calls one or two subroutines
+// a level down. Main calls into the top level over and over.
+static void generate_call(workload_t *w)
+{
+    uint16_t subs[WORKLOAD_CALL_DEPTH][WORKLOAD_CALL_WIDTH];
+    const uint16_t jump_to_main = here(w);
+    emit(w, 0x1000);
+
+    int32_t depth;
+    uint32_t s, c;
+    for (depth = WORKLOAD_CALL_DEPTH - 1; depth >= 0; --depth) {
+        for (s = 0; s < WORKLOAD_CALL_WIDTH; ++s) {
+            subs[depth][s] = here(w);
+            emit_alu(w);
+            if (depth < WORKLOAD_CALL_DEPTH - 1)
+                for (c = 0; c < 1 + random_below(w, 2); ++c)
+                    emit(w, 0x2000 | subs[depth + 1][random_below(w, WORKLOAD_CALL_WIDTH)]);
+            emit(w, 0x00EE);
+        }
+    }
+
+    patch(w, jump_to_main, 0x1000 | here(w));
+    while (room(w)) {
+        emit(w, 0x2000 | subs[0][random_below(w, WORKLOAD_CALL_WIDTH)]);
+        emit_alu(w);
+    }
+}
+
+// Each unit rewrites the instruction right after its own FX55 and then runs
+// it: the new opcode is an ADD, LD or SE immediate whose register and operand
+// come from a counter in V2, so every pass executes different code. Nothing
+// else writes V0-V2.
+static void generate_selfmod(workload_t *w)
+{
+    const uint8_t kinds[] = {0x60, 0x70, 0x30};
+
+    while (room(w)) {
+        const uint8_t X = 3 + random_below(w, 12);
+        emit(w, 0x7201 + random_below(w, 4));                       // ADD V2, 1-4
+        emit(w, 0x6000 | kinds[random_below(w, 3)] | X);            // LD V0, opcode high byte
+        emit(w, 0x8120);                                            // LD V1, V2
+        emit(w, 0xA000 | (here(w) + 4));                            // LD I, patch site
+        emit(w, 0xF155);                                            // LD [I], V0-V1
+        emit(w, 0x0000);                                            // Patch site
+        emit(w, 0x7000 | (3 + random_below(w, 12)) << 8 | random_below(w, 256));  // Skipped when the SE matches
+    }
+}
+
+// Runs of one to four skips of every kind ending in one ALU op, so taken skips
+// also skip over other skips. No keys are held, so EX9E never skips and EXA1 always does.
+static void generate_skip(workload_t *w)
+{
+    while (room(w)) {
+        const uint32_t chain = 1 + random_below(w, 4);
+        uint32_t i;
+        for (i = 0; i < chain; ++i) {
+            const uint16_t X = random_below(w, 16), Y = random_below(w, 16);
+            switch (random_below(w, 6)) {
+            case 0: emit(w, 0x3000 | X << 8 | random_below(w, 4)); break;
+            case 1: emit(w, 0x4000 | X << 8 | random_below(w, 4)); break;
+            case 2: emit(w, 0x5000 | X << 8 | Y << 4); break;
+            case 3: emit(w, 0x9000 | X << 8 | Y << 4); break;
+            case 4: emit(w, 0xE09E | X << 8); break;
+            default: emit(w, 0xE0A1 | X << 8); break;
+            }
+        }
+        // Keep register values small so the immediate compares sometimes match
+        emit(w, 0x6000 | random_below(w, 16) << 8 | random_below(w, 4));
+    }
+}
+
+static const struct {
+    const char  *name;
+    generate_t  generate;
+} mixes[] = {
+    {"alu",     generate_alu},
+    {"sprite",  generate_sprite},
+    {"call",    generate_call},
+    {"selfmod", generate_selfmod},
+    {"skip",    generate_skip},
+};
+
+#define MIX_COUNT (sizeof(mixes) / sizeof(mixes[0]))
+
+static bool write_workload(const uint32_t mix, const uint64_t seed, const char *path)
+{
+    static workload_t w;
+    memset(&w, 0, sizeof(w));
+    w.rng = seed * 0x9E3779B97F4A7C15ull + mix + 1;
+
+    const uint16_t start = here(&w);
+    mixes[mix].generate(&w);
+    emit(&w, 0x1000 | start);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    const bool ok = fwrite(w.rom, w.size, 1, file) == 1;
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return false;
+    }
+    printf("%s: %s mix, %u bytes, seed %llu\n", path, mixes[mix].name, w.size, (long long unsigned)seed);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <alu|sprite|call|selfmod|skip> <out.ch8> [--seed N]\n"
+                        "       %s all <directory> [--seed N]\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t seed = 1;
+    int i;
+    for (i = 3; i < argc; ++i) {
+        if (strncmp(argv[i], "--seed", strlen("--seed")) == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint32_t mix;
+    if (strcmp(argv[1], "all") == 0) {
+        char path[4096];
+        for (mix = 0; mix < MIX_COUNT; ++mix) {
+            snprintf(path, sizeof(path), "%s/%s.ch8", argv[2], mixes[mix].name);
+            if (!write_workload(mix, seed, path))
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    for (mix = 0; mix < MIX_COUNT; ++mix)
+        if (strcmp(argv[1], mixes[mix].name) == 0)
+            return write_workload(mix, seed, argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    fprintf(stderr, "Unknown mix %s\n", argv[1]);
+    return EXIT_FAILURE;
+}